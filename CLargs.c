@@ -10,15 +10,702 @@
  */
 
 #include "CLargs.h"
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
+#include <errno.h>
 #include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <locale.h>
+#include <unistd.h>
 
-// Starting capacities for the growable arrays that store the values and options
-#define DEFAULT_VALUE_CAP 9
-#define DEFAULT_OPTIONS_CAP 9
+extern char** environ;
+
+// ARENA
+
+// Alignment of every arena allocation
+#define ARENA_ALIGN _Alignof(max_align_t)
+
+// Chunk of arena memory (data follows the header)
+typedef struct CL_ArenaChunk {
+    struct CL_ArenaChunk* prev;
+    size_t size;
+    size_t used;
+} CL_ArenaChunk;
+
+// File mapping owned by an arena
+typedef struct CL_Mapping {
+    struct CL_Mapping* next;
+    void* addr;
+    size_t size;
+} CL_Mapping;
+
+// Arena holding all the memory of a parse result, stored at the start of its first chunk
+struct CL_Arena {
+    CL_Allocator allocator;
+    CL_ArenaChunk* chunk;
+    // Most recent allocation (can be grown in place)
+    void* last;
+    // Mapped response files, unmapped with the arena
+    CL_Mapping* mappings;
+};
+
+static void* mallocAllocator(size_t size, void* userData) {
+    (void)userData;
+    return malloc(size);
+}
+static void freeAllocator(void* ptr, void* userData) {
+    (void)userData;
+    free(ptr);
+}
+
+static const CL_Allocator defaultAllocator = {
+    .alloc = mallocAllocator,
+    .free = freeAllocator,
+    .userData = NULL,
+};
+
+static inline size_t alignUp(size_t size) {
+    return (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+}
+
+// Allocate a chunk with room for size bytes of data
+static CL_ArenaChunk* arenaNewChunk(const CL_Allocator* allocator, size_t size) {
+    CL_ArenaChunk* chunk = allocator->alloc(alignUp(sizeof(CL_ArenaChunk)) + size, allocator->userData);
+    if (!chunk) {
+        perror("[CLargs] malloc");
+        abort();
+    }
+    chunk->prev = NULL;
+    chunk->size = size;
+    chunk->used = 0;
+    return chunk;
+}
+
+// Create an arena whose first chunk can hold capacity bytes of allocations
+static CL_Arena* arenaCreate(const CL_Allocator* allocator, size_t capacity) {
+    CL_ArenaChunk* chunk = arenaNewChunk(allocator, alignUp(sizeof(CL_Arena)) + capacity);
+    CL_Arena* arena = (CL_Arena*)((char*)chunk + alignUp(sizeof(CL_ArenaChunk)));
+    chunk->used = alignUp(sizeof(CL_Arena));
+    arena->allocator = *allocator;
+    arena->chunk = chunk;
+    arena->last = NULL;
+    arena->mappings = NULL;
+    return arena;
+}
+
+// Allocate zeroed memory from the arena, adding a chunk (at least double the last one) when full
+static void* arenaAlloc(CL_Arena* arena, size_t size) {
+    size = alignUp(size);
+    CL_ArenaChunk* chunk = arena->chunk;
+    if (chunk->size - chunk->used < size) {
+        size_t chunk_size = chunk->size * 2;
+        if (chunk_size < size) {
+            chunk_size = size;
+        }
+        CL_ArenaChunk* new_chunk = arenaNewChunk(&arena->allocator, chunk_size);
+        new_chunk->prev = chunk;
+        arena->chunk = chunk = new_chunk;
+    }
+    void* ptr = (char*)chunk + alignUp(sizeof(CL_ArenaChunk)) + chunk->used;
+    chunk->used += size;
+    arena->last = ptr;
+    return memset(ptr, 0, size);
+}
+
+// Grow an arena allocation (in place if it was the most recent one and there is room)
+static void* arenaGrow(CL_Arena* arena, void* ptr, size_t old_size, size_t new_size) {
+    CL_ArenaChunk* chunk = arena->chunk;
+    if (ptr && ptr == arena->last) {
+        size_t offset = (char*)ptr - ((char*)chunk + alignUp(sizeof(CL_ArenaChunk)));
+        if (chunk->size - offset >= alignUp(new_size)) {
+            memset((char*)ptr + old_size, 0, alignUp(new_size) - old_size);
+            chunk->used = offset + alignUp(new_size);
+            return ptr;
+        }
+    }
+    void* new_ptr = arenaAlloc(arena, new_size);
+    if (ptr) {
+        memcpy(new_ptr, ptr, old_size);
+    }
+    return new_ptr;
+}
+
+// Release the mappings and all the chunks of an arena (the first chunk, holding the arena itself, last)
+static void arenaFree(CL_Arena* arena) {
+    for (CL_Mapping* mapping = arena->mappings; mapping; mapping = mapping->next) {
+        munmap(mapping->addr, mapping->size);
+    }
+    CL_Allocator allocator = arena->allocator;
+    CL_ArenaChunk* chunk = arena->chunk;
+    while (chunk) {
+        CL_ArenaChunk* prev = chunk->prev;
+        allocator.free(chunk, allocator.userData);
+        chunk = prev;
+    }
+}
+
+// RESPONSE FILES
+
+// Map a response file privately (writable, so it can be tokenized in place) with a zeroed byte
+// after its contents, and register the mapping in the arena. Returns NULL if it can't be read
+static char* mapResponseFile(CL_Arena* arena, const char* path, size_t* size) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        close(fd);
+        return NULL;
+    }
+    *size = (size_t)st.st_size;
+    // Reserve one more byte than the file in anonymous memory, then map the file over it, so
+    // the byte after the contents exists even when the file size is a multiple of the page size
+    char* data = mmap(NULL, *size + 1, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (data == MAP_FAILED) {
+        close(fd);
+        return NULL;
+    }
+    if (*size > 0 && mmap(data, *size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+        munmap(data, *size + 1);
+        close(fd);
+        return NULL;
+    }
+    close(fd);
+
+    CL_Mapping* mapping = arenaAlloc(arena, sizeof(CL_Mapping));
+    mapping->addr = data;
+    mapping->size = *size + 1;
+    mapping->next = arena->mappings;
+    arena->mappings = mapping;
+    return data;
+}
+
+static inline bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+}
+
+// Read the next whitespace-separated token of a response file, removing quotes and escapes in
+// place and NUL-terminating it. Returns NULL when there are no tokens left
+static char* nextResponseToken(char** cursor, char* end) {
+    char* read = *cursor;
+    while (read < end && isSpace(*read)) {
+        read++;
+    }
+    if (read == end) {
+        *cursor = end;
+        return NULL;
+    }
+    char* token = read;
+    char* write = read;
+    char quote = 0;
+    while (read < end && (quote || !isSpace(*read))) {
+        char c = *read++;
+        if (quote == '\'') {
+            // Single quotes: everything is literal until the closing quote
+            if (c == '\'') {
+                quote = 0;
+            } else {
+                *write++ = c;
+            }
+        } else if (c == '\\' && read < end) {
+            // Backslash escapes the next character (only quotes and backslashes inside double quotes)
+            if (!quote || *read == '"' || *read == '\\') {
+                c = *read++;
+            }
+            *write++ = c;
+        } else if (c == '"') {
+            quote = quote ? 0 : '"';
+        } else if (c == '\'' && !quote) {
+            quote = '\'';
+        } else {
+            *write++ = c;
+        }
+    }
+    // Skip the separator (the terminator may overwrite it, or the spare byte after the file)
+    *cursor = read < end ? read + 1 : end;
+    *write = '\0';
+    return token;
+}
+
+// CONFIG FILES
+
+// Entry of a config file (both strings point into the mapped file)
+typedef struct {
+    char* key;
+    char* value;
+} CL_ConfigEntry;
+
+// Sources of option values below argv
+typedef struct {
+    // Environment ("NAME=value" strings)
+    char** environ;
+    // Entries of the config file
+    CL_ConfigEntry* entries;
+    size_t entry_count;
+} CL_Layers;
+
+// Split a mapped config file into its "key = value" lines in place. Whitespace around keys and
+// values, and double quotes around values, are removed. Blank lines, lines starting with # or ;
+// and lines without = are ignored
+static void readConfigEntries(CL_Arena* arena, char* data, size_t size, CL_Layers* layers) {
+    char* end = data + size;
+    size_t line_count = 1;
+    for (char* line = data; (line = memchr(line, '\n', end - line)); line++) {
+        line_count++;
+    }
+    layers->entries = arenaAlloc(arena, line_count * sizeof(CL_ConfigEntry));
+    layers->entry_count = 0;
+
+    char* next;
+    for (char* line = data; line < end; line = next) {
+        char* eol = memchr(line, '\n', end - line);
+        if (!eol) {
+            eol = end;
+        }
+        next = eol + 1;
+        while (line < eol && isSpace(*line)) {
+            line++;
+        }
+        while (eol > line && isSpace(eol[-1])) {
+            eol--;
+        }
+        char* equals = memchr(line, '=', eol - line);
+        if (line == eol || *line == '#' || *line == ';' || !equals) {
+            continue;
+        }
+        char* key_end = equals;
+        while (key_end > line && isSpace(key_end[-1])) {
+            key_end--;
+        }
+        char* value = equals + 1;
+        while (value < eol && isSpace(*value)) {
+            value++;
+        }
+        if (eol - value >= 2 && *value == '"' && eol[-1] == '"') {
+            value++;
+            eol--;
+        }
+        // The end of the last line may be the zeroed byte after the file
+        *key_end = '\0';
+        *eol = '\0';
+        layers->entries[layers->entry_count++] = (CL_ConfigEntry){
+            .key = line,
+            .value = value,
+        };
+    }
+}
+
+// HELP
+
+// Growable text buffer for rendering the help menu
+typedef struct {
+    char* data;
+    size_t length;
+    size_t capacity;
+} CL_Buffer;
+
+// Make room for size more bytes (and a terminator) in a buffer
+static void bufferReserve(CL_Buffer* buffer, size_t size) {
+    if (buffer->length + size + 1 <= buffer->capacity) {
+        return;
+    }
+    size_t capacity = buffer->capacity ? buffer->capacity : 1024;
+    while (capacity < buffer->length + size + 1) {
+        capacity *= 2;
+    }
+    buffer->data = realloc(buffer->data, capacity);
+    if (!buffer->data) {
+        perror("[CLargs] malloc");
+        abort();
+    }
+    buffer->capacity = capacity;
+}
+
+static void bufferAppend(CL_Buffer* buffer, const char* string, size_t length) {
+    bufferReserve(buffer, length);
+    memcpy(buffer->data + buffer->length, string, length);
+    buffer->length += length;
+    buffer->data[buffer->length] = '\0';
+}
+
+static inline void bufferString(CL_Buffer* buffer, const char* string) {
+    bufferAppend(buffer, string, strlen(string));
+}
+
+static void bufferPad(CL_Buffer* buffer, size_t count) {
+    bufferReserve(buffer, count);
+    memset(buffer->data + buffer->length, ' ', count);
+    buffer->length += count;
+    buffer->data[buffer->length] = '\0';
+}
+
+static void bufferInt(CL_Buffer* buffer, int32_t value) {
+    char digits[12];
+    char* start = digits + sizeof(digits);
+    uint32_t magnitude = value < 0 ? 0u - (uint32_t)value : (uint32_t)value;
+    do {
+        *--start = '0' + magnitude % 10;
+        magnitude /= 10;
+    } while (magnitude);
+    if (value < 0) {
+        *--start = '-';
+    }
+    bufferAppend(buffer, start, digits + sizeof(digits) - start);
+}
+
+static void bufferDouble(CL_Buffer* buffer, double value) {
+    // Formatted directly into the buffer (no length is ever computed separately)
+    bufferReserve(buffer, 32);
+    int length = snprintf(buffer->data + buffer->length, 32, "%.2f", value);
+    if (length >= 32) {
+        bufferReserve(buffer, length);
+        snprintf(buffer->data + buffer->length, length + 1, "%.2f", value);
+    }
+    buffer->length += length;
+}
+
+// Append a string escaped for the output format (dashes and backslashes for man pages; pipes,
+// backticks, asterisks and underscores for Markdown)
+static void bufferEscaped(CL_Buffer* buffer, const char* string, CL_HelpFormat format) {
+    for (const char* c = string; *c; c++) {
+        if (format == CL_HELP_MAN && (*c == '-' || *c == '\\')) {
+            bufferAppend(buffer, "\\", 1);
+        } else if (format == CL_HELP_MARKDOWN && (*c == '|' || *c == '`' || *c == '*' || *c == '_')) {
+            bufferAppend(buffer, "\\", 1);
+        }
+        bufferAppend(buffer, c, 1);
+    }
+}
+
+// Whether an option is one of a fixed set of choices
+static inline bool hasChoices(const CL_Option* option) {
+    return option->type == STRING && option->strOptions.oneOf && option->strOptions.oneOf[0];
+}
+
+static inline bool isListType(CL_OptionType type) {
+    return type == STRING_LIST || type == INT_LIST || type == DOUBLE_LIST;
+}
+
+// Append the hint of the value an option takes (with a leading space, nothing if none)
+static void bufferHint(CL_Buffer* buffer, const CL_Option* option) {
+    switch (option->type) {
+        case STRING:
+            if (hasChoices(option)) {
+                bufferString(buffer, " (");
+                for (int o = 0; option->strOptions.oneOf[o]; o++) {
+                    if (o > 0) {
+                        bufferAppend(buffer, "/", 1);
+                    }
+                    bufferString(buffer, option->strOptions.oneOf[o]);
+                }
+                bufferAppend(buffer, ")", 1);
+            } else if (option->strOptions.optional) {
+                bufferString(buffer, " [value]");
+            } else {
+                bufferString(buffer, " (value)");
+            }
+            break;
+        case INT:
+            if (option->intOptions.minValue == 0 && option->intOptions.maxValue == 0) {
+                bufferString(buffer, " (int)");
+            } else {
+                bufferString(buffer, " (");
+                bufferInt(buffer, option->intOptions.minValue);
+                bufferString(buffer, "..");
+                bufferInt(buffer, option->intOptions.maxValue);
+                bufferAppend(buffer, ")", 1);
+            }
+            break;
+        case DOUBLE:
+            if (option->doubleOptions.minValue == 0.0 && option->doubleOptions.maxValue == 0.0) {
+                bufferString(buffer, " (num)");
+            } else {
+                bufferString(buffer, " (");
+                bufferDouble(buffer, option->doubleOptions.minValue);
+                bufferString(buffer, "..");
+                bufferDouble(buffer, option->doubleOptions.maxValue);
+                bufferAppend(buffer, ")", 1);
+            }
+            break;
+        case STRING_LIST:
+            bufferString(buffer, " (value...)");
+            break;
+        case INT_LIST:
+            bufferString(buffer, " (int...)");
+            break;
+        case DOUBLE_LIST:
+            bufferString(buffer, " (num...)");
+            break;
+        case END:
+        case HELP:
+        case BOOLEAN:
+        case SUBCOMMAND:
+            break;
+    }
+}
+
+// Append a description starting at the given column, wrapping words at the width (0 for no
+// wrapping) and indenting the following lines to that column
+static void bufferWrapped(CL_Buffer* buffer, const char* text, size_t column, unsigned width) {
+    // Too narrow to be worth wrapping
+    if (width == 0 || width < column + 20) {
+        bufferString(buffer, text);
+        return;
+    }
+    size_t line = column;
+    const char* word = text;
+    while (*word) {
+        const char* end = word;
+        while (*end && *end != ' ') {
+            end++;
+        }
+        size_t length = end - word;
+        if (line > column && line + 1 + length > width) {
+            bufferAppend(buffer, "\n", 1);
+            bufferPad(buffer, column);
+            line = column;
+        } else if (line > column) {
+            bufferAppend(buffer, " ", 1);
+            line++;
+        }
+        bufferAppend(buffer, word, length);
+        line += length;
+        word = *end ? end + 1 : end;
+    }
+}
+
+// Append the usage line of a schema
+static void bufferUsage(CL_Buffer* buffer, const char* progname, bool hasCommands) {
+    bufferString(buffer, progname);
+    bufferString(buffer, hasCommands ? " [options] <command> [arguments]" : " [values] [options]");
+}
+
+// Render the help menu of a schema into a buffer
+static void renderHelp(CL_Buffer* out, const CL_Option* schema, const char* progname, CL_HelpFormat format, unsigned width) {
+    bool hasCommands = false;
+    size_t maxCommandLength = 0;
+    size_t option_count = 0;
+    for (; schema[option_count].type != END; option_count++) {
+        if (schema[option_count].type == SUBCOMMAND) {
+            hasCommands = true;
+            size_t length = strlen(schema[option_count].name);
+            maxCommandLength = length > maxCommandLength ? length : maxCommandLength;
+        }
+    }
+
+    if (format == CL_HELP_MAN) {
+        bufferString(out, ".TH ");
+        bufferEscaped(out, progname ? progname : "command", format);
+        bufferString(out, " 1\n.SH SYNOPSIS\n");
+        if (progname) {
+            bufferString(out, ".B ");
+            bufferEscaped(out, progname, format);
+            bufferString(out, hasCommands ? "\n[options] <command> [arguments]\n" : "\n[values] [options]\n");
+        }
+        bufferString(out, ".SH OPTIONS\n");
+        for (size_t i = 0; i < option_count; i++) {
+            if (schema[i].type == SUBCOMMAND) {
+                continue;
+            }
+            bufferString(out, ".TP\n");
+            if (schema[i].abbr) {
+                char abbr[2] = {schema[i].abbr, '\0'};
+                bufferString(out, "\\fB\\-");
+                bufferEscaped(out, abbr, format);
+                bufferString(out, "\\fR, ");
+            }
+            bufferString(out, "\\fB\\-\\-");
+            bufferEscaped(out, schema[i].name, format);
+            bufferString(out, "\\fR");
+            CL_Buffer hint = {0};
+            bufferHint(&hint, &schema[i]);
+            if (hint.length) {
+                bufferEscaped(out, hint.data, format);
+            }
+            free(hint.data);
+            bufferAppend(out, "\n", 1);
+            bufferEscaped(out, schema[i].description, format);
+            if (schema[i].env) {
+                bufferString(out, " (environment variable \\fB");
+                bufferEscaped(out, schema[i].env, format);
+                bufferString(out, "\\fR)");
+            }
+            bufferAppend(out, "\n", 1);
+        }
+        if (hasCommands) {
+            bufferString(out, ".SH COMMANDS\n");
+            for (size_t i = 0; i < option_count; i++) {
+                if (schema[i].type == SUBCOMMAND) {
+                    bufferString(out, ".TP\n\\fB");
+                    bufferEscaped(out, schema[i].name, format);
+                    bufferString(out, "\\fR\n");
+                    bufferEscaped(out, schema[i].description, format);
+                    bufferAppend(out, "\n", 1);
+                }
+            }
+        }
+        return;
+    }
+
+    if (format == CL_HELP_MARKDOWN) {
+        if (progname) {
+            bufferString(out, "Usage: `");
+            bufferUsage(out, progname, hasCommands);
+            bufferString(out, "`\n\n");
+        }
+        bufferString(out, "## Options\n\n");
+        for (size_t i = 0; i < option_count; i++) {
+            if (schema[i].type == SUBCOMMAND) {
+                continue;
+            }
+            bufferString(out, "- `");
+            if (schema[i].abbr) {
+                char abbr[5] = {'-', schema[i].abbr, ',', ' ', '\0'};
+                bufferString(out, abbr);
+            }
+            bufferString(out, "--");
+            bufferString(out, schema[i].name);
+            bufferHint(out, &schema[i]);
+            bufferString(out, "`: ");
+            bufferEscaped(out, schema[i].description, format);
+            if (schema[i].env) {
+                bufferString(out, " (environment variable `");
+                bufferString(out, schema[i].env);
+                bufferString(out, "`)");
+            }
+            bufferAppend(out, "\n", 1);
+        }
+        if (hasCommands) {
+            bufferString(out, "\n## Commands\n\n");
+            for (size_t i = 0; i < option_count; i++) {
+                if (schema[i].type == SUBCOMMAND) {
+                    bufferString(out, "- `");
+                    bufferString(out, schema[i].name);
+                    bufferString(out, "`: ");
+                    bufferEscaped(out, schema[i].description, format);
+                    bufferAppend(out, "\n", 1);
+                }
+            }
+        }
+        return;
+    }
+
+    // Text: the flags and hints of the options form the left column, rendered first to align the descriptions
+    CL_Buffer left = {0};
+    size_t* ends = malloc((option_count + 1) * sizeof(size_t));
+    if (!ends) {
+        perror("[CLargs] malloc");
+        abort();
+    }
+    size_t maxLeftLength = 0;
+    for (size_t i = 0; i < option_count; i++) {
+        size_t start = left.length;
+        if (schema[i].type != SUBCOMMAND) {
+            bufferString(&left, schema[i].name);
+            bufferHint(&left, &schema[i]);
+        }
+        ends[i] = left.length;
+        if (left.length - start > maxLeftLength) {
+            maxLeftLength = left.length - start;
+        }
+    }
+
+    if (progname) {
+        bufferString(out, "Usage: ");
+        bufferUsage(out, progname, hasCommands);
+        bufferString(out, "\n\n");
+    }
+    bufferString(out, "Options:\n");
+    // Descriptions start after " -a, --" and the widest left column with a space
+    size_t column = 7 + maxLeftLength + 1;
+    for (size_t i = 0; i < option_count; i++) {
+        if (schema[i].type == SUBCOMMAND) {
+            continue;
+        }
+        size_t start = i > 0 ? ends[i - 1] : 0;
+        if (schema[i].abbr) {
+            char abbr[6] = {' ', '-', schema[i].abbr, ',', ' ', '\0'};
+            bufferString(out, abbr);
+        } else {
+            bufferPad(out, 5);
+        }
+        bufferString(out, "--");
+        bufferAppend(out, left.data + start, ends[i] - start);
+        bufferPad(out, maxLeftLength + 1 - (ends[i] - start));
+        bufferWrapped(out, schema[i].description, column, width);
+        if (schema[i].env) {
+            bufferString(out, " [$");
+            bufferString(out, schema[i].env);
+            bufferAppend(out, "]", 1);
+        }
+        bufferAppend(out, "\n", 1);
+    }
+    free(ends);
+    free(left.data);
+
+    if (hasCommands) {
+        bufferString(out, "\nCommands:\n");
+        for (size_t i = 0; i < option_count; i++) {
+            if (schema[i].type == SUBCOMMAND) {
+                size_t length = strlen(schema[i].name);
+                bufferAppend(out, " ", 1);
+                bufferAppend(out, schema[i].name, length);
+                bufferPad(out, maxCommandLength - length + 1);
+                bufferWrapped(out, schema[i].description, maxCommandLength + 2, width);
+                bufferAppend(out, "\n", 1);
+            }
+        }
+    }
+}
+
+// Width of the terminal on standard output (0 if it is not a terminal)
+static unsigned terminalWidth(void) {
+    struct winsize size;
+    if (isatty(STDOUT_FILENO) && ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) == 0) {
+        return size.ws_col;
+    }
+    return 0;
+}
+
+// Write a whole buffer to a file descriptor (a single write unless it is interrupted or partial,
+// retrying after a signal but failing if nothing can be written)
+static bool writeAll(int fd, const char* data, size_t length) {
+    while (length > 0) {
+        ssize_t written = write(fd, data, length);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return false;
+        }
+        data += written;
+        length -= written;
+    }
+    return true;
+}
+
+char* CL_renderHelp(const CL_Schema schema, const char* progname, CL_HelpFormat format, unsigned width, size_t* length) {
+    CL_Buffer buffer = {0};
+    bufferReserve(&buffer, 0);
+    buffer.data[0] = '\0';
+    renderHelp(&buffer, schema, progname, format, width);
+    if (length) {
+        *length = buffer.length;
+    }
+    return buffer.data;
+}
 
 // Default behaviour for argument parse error
 void defaultParseErrorCallback(const char* flag, char* msg) {
@@ -26,376 +713,3457 @@ void defaultParseErrorCallback(const char* flag, char* msg) {
     exit(EXIT_FAILURE);
 }
 
-// Default behaviour for --help (if enabled in schema)
-bool defaultHelpCallback(const CL_Schema schema, const char* progname) {
-    // Compute the maximum spacing needed for aligning flag descriptions
-    uint32_t maxSpacingLength = 0;
-    for (size_t i = 0; schema[i].type != END; i++) {
-        uint32_t argSpacingLength = strlen(schema[i].name) + 1;
-        switch (schema[i].type) {
-            case STRING:
-                if (schema[i].strOptions.oneOf[0]) {
-                    argSpacingLength += 2;  // (
-                    for (int o = 0; schema[i].strOptions.oneOf[o]; o++) {
-                        argSpacingLength += strlen(schema[i].strOptions.oneOf[o]) + 1;  // [value]/ + final )
+// Default behaviour for --help (if enabled in schema)
+bool defaultHelpCallback(const CL_Schema schema, const char* progname) {
+    size_t length;
+    char* help = CL_renderHelp(schema, progname, CL_HELP_TEXT, terminalWidth(), &length);
+    // Anything the program printed before goes first
+    fflush(stdout);
+    writeAll(STDOUT_FILENO, help, length);
+    free(help);
+    return true;
+}
+
+CL_ParseErrorCallback parseErrorCallback = defaultParseErrorCallback;
+CL_HelpCallback helpCallback = defaultHelpCallback;
+
+void CL_setParseErrorCallback(CL_ParseErrorCallback cb) {
+    parseErrorCallback = cb;
+}
+void CL_setHelpCallback(CL_HelpCallback cb) {
+    helpCallback = cb;
+}
+
+// SCHEMA INDEX
+
+// Option name and index, sorted by name in compiled schemas
+typedef struct {
+    const char* name;
+    int32_t index;
+} CL_SortedName;
+
+// What lookups and the parser read of an option, packed densely (the schema holds the rest:
+// names, descriptions, ranges and choices)
+typedef struct {
+    // Name hash (avoids most strcmp calls on lookup)
+    uint32_t hash;
+    uint8_t type;
+    char abbr;
+    // How values are matched to the choices (CL_MATCH_* flags)
+    uint8_t choice_match;
+    // Choice set of the option: offset in choice_table and mask of its size (a power of 2), or
+    // -1 if the option takes any value
+    int32_t choices;
+    uint32_t choice_mask;
+} CL_HotOption;
+
+// Constraint of a compiled schema, over the bitset of terms set by a parse: a bit per option
+// (set explicitly), then a bit per choice term
+typedef struct {
+    CL_ConstraintKind kind;
+    // Term of the first option: the one REQUIRES and CONFLICTS apply to (their mask holds the
+    // others), or the one groups report as missing
+    uint32_t subject;
+    // Terms of the constraint (term_words words)
+    const uint64_t* mask;
+    // Constraint as declared, for the names of its options in errors
+    const CL_Constraint* source;
+} CL_CompiledConstraint;
+
+// Term of a constraint that is a "one of" option set to one of its choices ("name=choice")
+typedef struct {
+    int32_t option;
+    int32_t choice;
+} CL_ChoiceTerm;
+
+// Compiled schema: hash index over option names and direct table over abbreviations
+struct CL_Compiled {
+    const CL_Option* schema;
+    uint32_t option_count;
+    // Open-addressed hash table of option indices (-1 for empty slots), size is a power of 2
+    uint32_t table_mask;
+    int32_t* table;
+    // Hot data of each option
+    CL_HotOption* hot;
+    // Open-addressed hash sets of the choice indices of each option with choices (-1 for empty
+    // slots), probed like the name table
+    int32_t* choice_table;
+    // Option index for each abbreviation character (-1 if none)
+    int32_t abbr_index[256];
+    // Bitmap of the abbreviations of boolean options
+    uint64_t boolean_abbrs[4];
+    // Option names in sorted order without duplicates (nor subcommands), for prefix matching
+    CL_SortedName* sorted;
+    uint32_t sorted_count;
+    // Whether the schema has subcommands, and their compiled schemas (indexed by option, NULL
+    // until the subcommand is first selected)
+    bool has_subcommands;
+    _Atomic(CL_Compiled*)* children;
+    // Help menu (without the usage line), rendered the first time it is printed
+    _Atomic(char*)* help;
+    // Whether an option has an environment variable or config key, and hash tables over them
+    // (same size and probing as the name table)
+    bool has_layers;
+    int32_t* env_table;
+    int32_t* key_table;
+    // Constraints of the schema, and the choice terms they name. Their masks are term_words words
+    // long (the bits of the options, then those of the choice terms)
+    CL_CompiledConstraint* constraints;
+    uint32_t constraint_count;
+    CL_ChoiceTerm* choice_terms;
+    uint32_t choice_term_count;
+    uint32_t term_words;
+    // Allocator of this block and of the compiled schemas of the subcommands
+    CL_Allocator allocator;
+};
+
+// FNV-1a hash of the first len characters of a string
+static uint32_t hashName(const char* name, size_t len) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (unsigned char)name[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// FNV-1a hash of a flag name, which ends at the end of the string or at "=" (its length is
+// stored in len), so that an inline value is found in the same scan
+static inline uint32_t hashFlagName(const char* name, size_t* len) {
+    uint32_t hash = 2166136261u;
+    const char* c = name;
+    for (; *c && *c != '='; c++) {
+        hash ^= (unsigned char)*c;
+        hash *= 16777619u;
+    }
+    *len = c - name;
+    return hash;
+}
+
+// ASCII letter in lower case (other characters unchanged)
+static inline unsigned char foldCase(unsigned char c) {
+    return c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c;
+}
+
+// FNV-1a hash of a choice or value of a "one of" option (ignoring the case of letters if nocase)
+static uint32_t hashChoice(const char* value, size_t len, bool nocase) {
+    if (!nocase) {
+        return hashName(value, len);
+    }
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= foldCase((unsigned char)value[i]);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Whether a choice starts with the first len characters of a value (ignoring case if nocase)
+static bool choiceStartsWith(const char* choice, const char* value, size_t len, bool nocase) {
+    if (!nocase) {
+        return strncmp(choice, value, len) == 0;
+    }
+    for (size_t i = 0; i < len; i++) {
+        if (foldCase((unsigned char)choice[i]) != foldCase((unsigned char)value[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static int compareSortedNames(const void* a, const void* b) {
+    const CL_SortedName* x = a;
+    const CL_SortedName* y = b;
+    int order = strcmp(x->name, y->name);
+    return order ? order : (x->index > y->index) - (x->index < y->index);
+}
+
+// Environment variable or config key of an option
+static inline const char* layerName(const CL_Option* option, bool env) {
+    return env ? option->env : option->configKey;
+}
+
+// Insert an option in the table of its environment variable or config key (if it has one),
+// keeping the first definition of duplicates
+static void insertLayerName(CL_Compiled* compiled, int32_t* table, bool env, uint32_t i) {
+    const char* name = layerName(&compiled->schema[i], env);
+    if (!name) {
+        return;
+    }
+    compiled->has_layers = true;
+    uint32_t slot = hashName(name, strlen(name)) & compiled->table_mask;
+    for (; table[slot] >= 0; slot = (slot + 1) & compiled->table_mask) {
+        if (strcmp(layerName(&compiled->schema[table[slot]], env), name) == 0) {
+            return;
+        }
+    }
+    table[slot] = i;
+}
+
+// Find the option with the given environment variable or config key (not NUL-terminated), SIZE_MAX if none
+static size_t findLayerName(const CL_Compiled* compiled, const int32_t* table, bool env, const char* name, size_t len) {
+    for (uint32_t slot = hashName(name, len) & compiled->table_mask; table[slot] >= 0; slot = (slot + 1) & compiled->table_mask) {
+        const char* other = layerName(&compiled->schema[table[slot]], env);
+        if (strncmp(other, name, len) == 0 && other[len] == '\0') {
+            return table[slot];
+        }
+    }
+    return SIZE_MAX;
+}
+
+// Size of the choice set of an option with choices (a power of 2, keeping the set at most half full)
+static uint32_t choiceSetSize(const CL_Option* option) {
+    uint32_t count = 0;
+    while (option->strOptions.oneOf[count]) {
+        count++;
+    }
+    uint32_t size = 1;
+    while (size < count * 2) {
+        size <<= 1;
+    }
+    return size;
+}
+
+// Find the index of a long option name of the given length and hash (SIZE_MAX if not found)
+static size_t findHashedOption(const CL_Compiled* compiled, const char* name, size_t len, uint32_t hash) {
+    for (uint32_t slot = hash & compiled->table_mask; compiled->table[slot] >= 0; slot = (slot + 1) & compiled->table_mask) {
+        int32_t i = compiled->table[slot];
+        if (compiled->hot[i].hash == hash && strncmp(compiled->schema[i].name, name, len) == 0 && compiled->schema[i].name[len] == '\0') {
+            return i;
+        }
+    }
+    return SIZE_MAX;
+}
+
+// Term of an option named in a constraint: its index, or for "name=choice" a choice term (added
+// the first time it is named). Aborts if the schema has no such option or choice
+static uint32_t constraintTerm(CL_Compiled* compiled, const char* name) {
+    size_t len;
+    uint32_t hash = hashFlagName(name, &len);
+    size_t i = findHashedOption(compiled, name, len, hash);
+    if (i != SIZE_MAX && name[len] == '\0') {
+        return i;
+    }
+    int32_t choice = -1;
+    for (int32_t o = 0; i != SIZE_MAX && hasChoices(&compiled->schema[i]) && compiled->schema[i].strOptions.oneOf[o]; o++) {
+        if (strcmp(compiled->schema[i].strOptions.oneOf[o], name + len + 1) == 0) {
+            choice = o;
+            break;
+        }
+    }
+    if (choice < 0) {
+        fprintf(stderr, "[CLargs] Unknown option in constraint: %s\n", name);
+        abort();
+    }
+    uint32_t t = 0;
+    while (t < compiled->choice_term_count && (compiled->choice_terms[t].option != (int32_t)i || compiled->choice_terms[t].choice != choice)) {
+        t++;
+    }
+    if (t == compiled->choice_term_count) {
+        compiled->choice_terms[compiled->choice_term_count++] = (CL_ChoiceTerm){.option = i, .choice = choice};
+    }
+    return compiled->option_count + t;
+}
+
+// Longest list of the options of a group reported as the flag of an error (longer lists are cut)
+#define MAX_GROUP_NAMES_LENGTH 256
+
+// Option of a constraint term (see CL_Compiled.constraints)
+static CL_FlagId termOption(const CL_Compiled* compiled, uint32_t term) {
+    return term < compiled->option_count ? (CL_FlagId)term : compiled->choice_terms[term - compiled->option_count].option;
+}
+
+// Compile a schema into a single block allocated with allocator
+static CL_Compiled* compileSchema(const CL_Schema schema, const CL_Allocator* allocator) {
+    uint32_t option_count = 0;
+    uint32_t choice_size = 0;
+    for (; schema[option_count].type != END; option_count++) {
+        if (hasChoices(&schema[option_count])) {
+            choice_size += choiceSetSize(&schema[option_count]);
+        }
+    }
+    // The constraints are on the END entry, and name at most one choice term per "="
+    const CL_Constraint* constraints = schema[option_count].constraints;
+    uint32_t constraint_count = 0;
+    uint32_t term_cap = 0;
+    for (; constraints && constraints[constraint_count].kind != CL_CONSTRAINT_END; constraint_count++) {
+        for (const char* const* name = constraints[constraint_count].options; *name; name++) {
+            term_cap += strchr(*name, '=') != NULL;
+        }
+    }
+    uint32_t term_words = (option_count + term_cap + 63) / 64;
+    // Keep the table at most half full
+    uint32_t table_size = 1;
+    while (table_size < option_count * 2) {
+        table_size <<= 1;
+    }
+
+    // Allocate the compiled object and its arrays in a single block
+    CL_Compiled* compiled = allocator->alloc(sizeof(CL_Compiled) + sizeof(*compiled->help) + option_count * (sizeof(*compiled->children) + sizeof(CL_SortedName)) +
+                                                 constraint_count * (sizeof(CL_CompiledConstraint) + term_words * sizeof(uint64_t)) + 3 * table_size * sizeof(int32_t) +
+                                                 option_count * sizeof(CL_HotOption) + choice_size * sizeof(int32_t) + term_cap * sizeof(CL_ChoiceTerm),
+                                             allocator->userData);
+    if (!compiled) {
+        perror("[CLargs] malloc");
+        abort();
+    }
+    compiled->allocator = *allocator;
+    compiled->schema = schema;
+    compiled->option_count = option_count;
+    compiled->table_mask = table_size - 1;
+    compiled->has_subcommands = false;
+    compiled->help = (_Atomic(char*)*)(compiled + 1);
+    atomic_init(compiled->help, NULL);
+    compiled->children = (_Atomic(CL_Compiled*)*)(compiled->help + 1);
+    compiled->has_layers = false;
+    compiled->sorted = (CL_SortedName*)(compiled->children + option_count);
+    compiled->sorted_count = 0;
+    compiled->constraints = (CL_CompiledConstraint*)(compiled->sorted + option_count);
+    compiled->constraint_count = constraint_count;
+    compiled->term_words = term_words;
+    uint64_t* masks = (uint64_t*)(compiled->constraints + constraint_count);
+    compiled->table = (int32_t*)(masks + constraint_count * term_words);
+    compiled->env_table = compiled->table + table_size;
+    compiled->key_table = compiled->env_table + table_size;
+    compiled->hot = (CL_HotOption*)(compiled->key_table + table_size);
+    compiled->choice_table = (int32_t*)(compiled->hot + option_count);
+    compiled->choice_terms = (CL_ChoiceTerm*)(compiled->choice_table + choice_size);
+    compiled->choice_term_count = 0;
+    memset(masks, 0, constraint_count * term_words * sizeof(uint64_t));
+    memset(compiled->table, 0xFF, 3 * table_size * sizeof(int32_t));
+    memset(compiled->choice_table, 0xFF, choice_size * sizeof(int32_t));
+    memset(compiled->abbr_index, 0xFF, sizeof(compiled->abbr_index));
+    memset(compiled->boolean_abbrs, 0, sizeof(compiled->boolean_abbrs));
+
+    int32_t choice_offset = 0;
+    for (uint32_t i = 0; i < option_count; i++) {
+        // Subcommand schemas are only compiled when selected
+        atomic_init(&compiled->children[i], NULL);
+        if (schema[i].type == SUBCOMMAND) {
+            compiled->has_subcommands = true;
+        }
+        uint32_t hash = hashName(schema[i].name, strlen(schema[i].name));
+        compiled->hot[i] = (CL_HotOption){.hash = hash, .type = schema[i].type, .abbr = schema[i].abbr, .choices = -1};
+        // Insert by linear probing, keeping the first definition of duplicate names
+        uint32_t slot = hash & compiled->table_mask;
+        bool duplicate = false;
+        while (compiled->table[slot] >= 0) {
+            int32_t other = compiled->table[slot];
+            if (compiled->hot[other].hash == hash && strcmp(schema[other].name, schema[i].name) == 0) {
+                duplicate = true;
+                break;
+            }
+            slot = (slot + 1) & compiled->table_mask;
+        }
+        if (!duplicate) {
+            compiled->table[slot] = i;
+        }
+        // Same for abbreviations (0 meaning no abbreviation)
+        unsigned char abbr = (unsigned char)schema[i].abbr;
+        if (abbr && compiled->abbr_index[abbr] < 0) {
+            compiled->abbr_index[abbr] = i;
+            if (schema[i].type == BOOLEAN) {
+                compiled->boolean_abbrs[abbr >> 6] |= 1ull << (abbr & 63);
+            }
+        }
+        // Hash the choices into the option's choice set
+        if (hasChoices(&schema[i])) {
+            uint32_t size = choiceSetSize(&schema[i]);
+            bool nocase = schema[i].strOptions.match & CL_MATCH_NOCASE;
+            compiled->hot[i].choice_match = schema[i].strOptions.match;
+            compiled->hot[i].choices = choice_offset;
+            compiled->hot[i].choice_mask = size - 1;
+            int32_t* set = compiled->choice_table + choice_offset;
+            for (int32_t o = 0; schema[i].strOptions.oneOf[o]; o++) {
+                const char* choice = schema[i].strOptions.oneOf[o];
+                uint32_t choice_slot = hashChoice(choice, strlen(choice), nocase) & (size - 1);
+                while (set[choice_slot] >= 0) {
+                    choice_slot = (choice_slot + 1) & (size - 1);
+                }
+                set[choice_slot] = o;
+            }
+            choice_offset += size;
+        }
+        insertLayerName(compiled, compiled->env_table, true, i);
+        insertLayerName(compiled, compiled->key_table, false, i);
+        if (schema[i].type != SUBCOMMAND) {
+            compiled->sorted[compiled->sorted_count++] = (CL_SortedName){.name = schema[i].name, .index = i};
+        }
+    }
+    // Sort the names, keeping the first definition of duplicates
+    qsort(compiled->sorted, compiled->sorted_count, sizeof(CL_SortedName), compareSortedNames);
+    uint32_t unique = 0;
+    for (uint32_t i = 0; i < compiled->sorted_count; i++) {
+        if (unique == 0 || strcmp(compiled->sorted[unique - 1].name, compiled->sorted[i].name) != 0) {
+            compiled->sorted[unique++] = compiled->sorted[i];
+        }
+    }
+    compiled->sorted_count = unique;
+
+    // Resolve the options of the constraints to the bits of their terms
+    for (uint32_t c = 0; c < constraint_count; c++) {
+        CL_ConstraintKind kind = constraints[c].kind;
+        uint64_t* mask = masks + c * term_words;
+        compiled->constraints[c] = (CL_CompiledConstraint){.kind = kind, .mask = mask, .source = &constraints[c]};
+        for (uint32_t o = 0; constraints[c].options[o]; o++) {
+            uint32_t term = constraintTerm(compiled, constraints[c].options[o]);
+            if (o == 0) {
+                compiled->constraints[c].subject = term;
+            }
+            if (o > 0 || (kind != CL_CONSTRAINT_REQUIRES && kind != CL_CONSTRAINT_CONFLICTS)) {
+                mask[term >> 6] |= 1ull << (term & 63);
+            }
+        }
+    }
+
+    return compiled;
+}
+
+CL_Compiled* CL_compileSchema(const CL_Schema schema) {
+    return compileSchema(schema, &defaultAllocator);
+}
+
+void CL_freeCompiled(CL_Compiled* compiled) {
+    if (!compiled) {
+        return;
+    }
+    for (uint32_t i = 0; compiled->has_subcommands && i < compiled->option_count; i++) {
+        CL_freeCompiled(atomic_load_explicit(&compiled->children[i], memory_order_relaxed));
+    }
+    free(atomic_load_explicit(compiled->help, memory_order_relaxed));
+    compiled->allocator.free(compiled, compiled->allocator.userData);
+}
+
+// Compiled schema of a subcommand, compiled the first time it is needed (threads racing to
+// compile it keep the first one published)
+static const CL_Compiled* subcommandCompiled(const CL_Compiled* compiled, size_t i) {
+    CL_Compiled* child = atomic_load_explicit(&compiled->children[i], memory_order_acquire);
+    if (!child) {
+        CL_Compiled* fresh = compileSchema(compiled->schema[i].subcommand.schema, &compiled->allocator);
+        if (atomic_compare_exchange_strong_explicit(&compiled->children[i], &child, fresh, memory_order_acq_rel, memory_order_acquire)) {
+            child = fresh;
+        } else {
+            CL_freeCompiled(fresh);
+        }
+    }
+    return child;
+}
+
+const char* CL_compiledHelp(const CL_Compiled* compiled) {
+    char* help = atomic_load_explicit(compiled->help, memory_order_acquire);
+    if (!help) {
+        char* fresh = CL_renderHelp(compiled->schema, NULL, CL_HELP_TEXT, terminalWidth(), NULL);
+        if (atomic_compare_exchange_strong_explicit(compiled->help, &help, fresh, memory_order_acq_rel, memory_order_acquire)) {
+            help = fresh;
+        } else {
+            free(fresh);
+        }
+    }
+    return help;
+}
+
+bool CL_printHelp(int fd, const CL_Compiled* compiled, const char* progname) {
+    const char* help = CL_compiledHelp(compiled);
+    // The usage line is rendered as by CL_renderHelp
+    CL_Buffer usage = {0};
+    if (progname) {
+        bufferString(&usage, "Usage: ");
+        bufferUsage(&usage, progname, compiled->has_subcommands);
+        bufferString(&usage, "\n\n");
+    }
+    struct iovec parts[] = {
+        {.iov_base = usage.data, .iov_len = usage.length},
+        {.iov_base = (char*)help, .iov_len = strlen(help)},
+    };
+    // One system call, unless the write is interrupted or partial
+    ssize_t written = writev(fd, parts, sizeof(parts) / sizeof(parts[0]));
+    if (written < 0 && errno == EINTR) {
+        written = 0;
+    }
+    bool ok = written >= 0;
+    for (size_t i = 0; ok && i < sizeof(parts) / sizeof(parts[0]); i++) {
+        size_t done = (size_t)written < parts[i].iov_len ? (size_t)written : parts[i].iov_len;
+        written -= done;
+        ok = writeAll(fd, (char*)parts[i].iov_base + done, parts[i].iov_len - done);
+    }
+    free(usage.data);
+    return ok;
+}
+
+// Find the index of a long option name (SIZE_MAX if not found)
+static size_t findLongOption(const CL_Compiled* compiled, const char* name) {
+    size_t len = strlen(name);
+    return findHashedOption(compiled, name, len, hashName(name, len));
+}
+
+// Position of the first sorted name not before the given prefix (names starting with the prefix follow)
+static uint32_t findPrefixStart(const CL_Compiled* compiled, const char* prefix, size_t len) {
+    uint32_t low = 0;
+    uint32_t high = compiled->sorted_count;
+    while (low < high) {
+        uint32_t middle = low + (high - low) / 2;
+        if (strncmp(compiled->sorted[middle].name, prefix, len) < 0) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+// Find the only option whose name starts with the given prefix (SIZE_MAX if none, or if several
+// do, in which case ambiguous is set)
+static size_t findPrefixOption(const CL_Compiled* compiled, const char* prefix, size_t len, bool* ambiguous) {
+    uint32_t low = findPrefixStart(compiled, prefix, len);
+    *ambiguous = false;
+    if (len == 0 || low == compiled->sorted_count || strncmp(compiled->sorted[low].name, prefix, len) != 0) {
+        return SIZE_MAX;
+    }
+    if (low + 1 < compiled->sorted_count && strncmp(compiled->sorted[low + 1].name, prefix, len) == 0) {
+        *ambiguous = true;
+        return SIZE_MAX;
+    }
+    return compiled->sorted[low].index;
+}
+
+// Find the index of a short option abbreviation (SIZE_MAX if not found)
+static inline size_t findShortOption(const CL_Compiled* compiled, char abbr) {
+    int32_t i = compiled->abbr_index[(unsigned char)abbr];
+    return i < 0 ? SIZE_MAX : (size_t)i;
+}
+
+// Index of the choice of an option with choices that a value matches, found in its choice set
+// (or, with CL_MATCH_PREFIX, the only choice starting with the value). -1 if none (or several)
+static int32_t findChoice(const CL_Compiled* compiled, size_t i, const char* value) {
+    const CL_HotOption* hot = &compiled->hot[i];
+    const int32_t* set = compiled->choice_table + hot->choices;
+    const char* const* oneOf = compiled->schema[i].strOptions.oneOf;
+    bool nocase = hot->choice_match & CL_MATCH_NOCASE;
+    size_t len = strlen(value);
+    for (uint32_t slot = hashChoice(value, len, nocase) & hot->choice_mask; set[slot] >= 0; slot = (slot + 1) & hot->choice_mask) {
+        if (choiceStartsWith(oneOf[set[slot]], value, len, nocase) && oneOf[set[slot]][len] == '\0') {
+            return set[slot];
+        }
+    }
+    if (!(hot->choice_match & CL_MATCH_PREFIX)) {
+        return -1;
+    }
+    int32_t found = -1;
+    for (int32_t o = 0; oneOf[o]; o++) {
+        if (choiceStartsWith(oneOf[o], value, len, nocase)) {
+            if (found >= 0) {
+                return -1;
+            }
+            found = o;
+        }
+    }
+    return found;
+}
+
+// SUGGESTIONS
+
+// Longest flag name suggestions are computed for (the pattern must fit in a machine word)
+#define MAX_SUGGESTION_LENGTH 64
+
+// Levenshtein distance between a pattern and a text, computed a column at a time with the
+// bit-parallel algorithm of Myers (as formulated by Hyyro) using the pattern's character masks.
+// Returns a value greater than bound as soon as the distance is known to exceed it
+static uint32_t boundedDistance(const uint64_t* masks, uint32_t m, const char* text, uint32_t n, uint32_t bound) {
+    uint64_t last = 1ull << (m - 1);
+    uint64_t pv = m == 64 ? ~0ull : (1ull << m) - 1;
+    uint64_t mv = 0;
+    uint32_t score = m;
+    for (uint32_t j = 0; j < n; j++) {
+        uint64_t eq = masks[(unsigned char)text[j]];
+        uint64_t xv = eq | mv;
+        uint64_t xh = (((eq & pv) + pv) ^ pv) | eq;
+        uint64_t ph = mv | ~(xh | pv);
+        uint64_t mh = pv & xh;
+        if (ph & last) {
+            score++;
+        } else if (mh & last) {
+            score--;
+        }
+        // The distance can decrease by at most 1 per remaining column
+        if (score > bound + (n - j - 1)) {
+            return bound + 1;
+        }
+        ph = (ph << 1) | 1;
+        mh <<= 1;
+        pv = mh | ~(xv | ph);
+        mv = ph & xv;
+    }
+    return score;
+}
+
+// Closest option to the first m characters of name (CL_NO_FLAG if none is close enough)
+static CL_FlagId suggestOption(const CL_Compiled* compiled, const char* name, uint32_t m) {
+    if (m == 0 || m > MAX_SUGGESTION_LENGTH) {
+        return CL_NO_FLAG;
+    }
+    // Allow about one edit per 3 characters, at most 3
+    uint32_t bound = m < 4 ? 1 : m < 9 ? 2 : 3;
+    uint64_t masks[256] = {0};
+    for (uint32_t i = 0; i < m; i++) {
+        masks[(unsigned char)name[i]] |= 1ull << i;
+    }
+    CL_FlagId best = CL_NO_FLAG;
+    for (uint32_t i = 0; i < compiled->option_count; i++) {
+        const CL_Option* option = &compiled->schema[i];
+        uint32_t n = strlen(option->name);
+        // The distance is at least the difference in length
+        if (option->type == SUBCOMMAND || (n > m ? n - m : m - n) > bound) {
+            continue;
+        }
+        uint32_t distance = boundedDistance(masks, m, option->name, n, bound);
+        if (distance <= bound) {
+            best = i;
+            // Only closer names are of interest from now on
+            if (distance == 0) {
+                break;
+            }
+            bound = distance - 1;
+        }
+    }
+    return best;
+}
+
+CL_FlagId CL_suggest(const CL_Compiled* compiled, const char* name) {
+    return suggestOption(compiled, name, strlen(name));
+}
+
+// COMPLETION
+
+// Whether an option takes a value (its inline value, or else the next argument unless it is a long flag)
+static inline bool takesValue(const CL_Option* option) {
+    return option->type != BOOLEAN && option->type != HELP && option->type != SUBCOMMAND && option->type != END;
+}
+
+// Option named by a flag (exact long name, unique prefix or abbreviation), NULL if none. The
+// name ends at an "=", whose position is stored in equals (NULL if there is none)
+static const CL_Option* completionFlag(const CL_Compiled* compiled, const char* word, const char** equals) {
+    *equals = NULL;
+    size_t i;
+    if (word[1] != '-') {
+        i = word[2] == '\0' ? findShortOption(compiled, word[1]) : SIZE_MAX;
+    } else {
+        size_t len;
+        uint32_t hash = hashFlagName(word + 2, &len);
+        if (word[2 + len] == '=') {
+            *equals = word + 2 + len;
+        }
+        i = findHashedOption(compiled, word + 2, len, hash);
+        if (i == SIZE_MAX) {
+            bool ambiguous;
+            i = findPrefixOption(compiled, word + 2, len, &ambiguous);
+        }
+    }
+    return i == SIZE_MAX || compiled->schema[i].type == SUBCOMMAND ? NULL : &compiled->schema[i];
+}
+
+// Append a candidate (a lead such as "--name=" followed by a word) as a line
+static void bufferCandidate(CL_Buffer* out, const char* lead, size_t leadLength, const char* word) {
+    bufferAppend(out, lead, leadLength);
+    bufferString(out, word);
+    bufferAppend(out, "\n", 1);
+}
+
+// Append the choices of an option that start with the given prefix (ignoring case if the option
+// does)
+static void completeChoices(CL_Buffer* out, const CL_Option* option, const char* lead, size_t leadLength, const char* prefix) {
+    if (!hasChoices(option)) {
+        return;
+    }
+    size_t len = strlen(prefix);
+    bool nocase = option->strOptions.match & CL_MATCH_NOCASE;
+    for (int o = 0; option->strOptions.oneOf[o]; o++) {
+        if (choiceStartsWith(option->strOptions.oneOf[o], prefix, len, nocase)) {
+            bufferCandidate(out, lead, leadLength, option->strOptions.oneOf[o]);
+        }
+    }
+}
+
+// Append the candidates for the last of count words, following the parser over the words before it
+static void completeWords(CL_Buffer* out, const CL_Compiled* compiled, int count, char** words) {
+    const char* current = words[count - 1];
+    const CL_Option* pending = NULL;
+    bool seenValue = false;
+    const char* equals;
+    for (int w = 0; w < count - 1; w++) {
+        const char* word = words[w];
+        bool isLongFlag = word[0] == '-' && word[1] == '-';
+        // The value of the previous flag (which doesn't take long flags as values)
+        if (pending && !isLongFlag) {
+            pending = NULL;
+            continue;
+        }
+        pending = NULL;
+        if (word[0] != '-' || word[1] == '\0') {
+            // The first value may select a subcommand, whose schema completes the words after it
+            if (!seenValue && compiled->has_subcommands) {
+                size_t i = findLongOption(compiled, word);
+                if (i != SIZE_MAX && compiled->schema[i].type == SUBCOMMAND) {
+                    completeWords(out, subcommandCompiled(compiled, i), count - w - 1, words + w + 1);
+                    return;
+                }
+            }
+            seenValue = true;
+            continue;
+        }
+        const CL_Option* option = completionFlag(compiled, word, &equals);
+        if (option && !equals && takesValue(option)) {
+            pending = option;
+        }
+    }
+
+    if (pending && (current[0] != '-' || current[1] != '-')) {
+        completeChoices(out, pending, "", 0, current);
+    } else if (current[0] == '-' && current[1] == '-') {
+        const CL_Option* option = completionFlag(compiled, current, &equals);
+        if (equals) {
+            if (option) {
+                completeChoices(out, option, current, equals + 1 - current, equals + 1);
+            }
+            return;
+        }
+        // Every name with the prefix, which are contiguous in the sorted names
+        size_t len = strlen(current + 2);
+        for (uint32_t s = findPrefixStart(compiled, current + 2, len);
+             s < compiled->sorted_count && strncmp(compiled->sorted[s].name, current + 2, len) == 0; s++) {
+            bufferCandidate(out, "--", 2, compiled->sorted[s].name);
+        }
+    } else if (current[0] == '-') {
+        // Abbreviations (only a lone dash can start one), then long names
+        for (uint32_t i = 0; current[1] == '\0' && i < compiled->option_count; i++) {
+            if (compiled->schema[i].abbr && compiled->abbr_index[(unsigned char)compiled->schema[i].abbr] == (int32_t)i) {
+                char abbr[3] = {'-', compiled->schema[i].abbr, '\0'};
+                bufferCandidate(out, abbr, 2, "");
+            }
+        }
+        for (uint32_t s = 0; current[1] == '\0' && s < compiled->sorted_count; s++) {
+            bufferCandidate(out, "--", 2, compiled->sorted[s].name);
+        }
+    } else if (!seenValue && compiled->has_subcommands) {
+        size_t len = strlen(current);
+        for (uint32_t i = 0; i < compiled->option_count; i++) {
+            if (compiled->schema[i].type == SUBCOMMAND && strncmp(compiled->schema[i].name, current, len) == 0) {
+                bufferCandidate(out, "", 0, compiled->schema[i].name);
+            }
+        }
+    }
+}
+
+bool CL_complete(int argc, char* argv[], const CL_Compiled* compiled) {
+    if (argc < 2 || strcmp(argv[1], "__complete") != 0) {
+        return false;
+    }
+    // Without any word, the empty word is completed
+    char* empty[] = {""};
+    CL_Buffer out = {0};
+    bufferReserve(&out, 0);
+    completeWords(&out, compiled, argc > 2 ? argc - 2 : 1, argc > 2 ? argv + 2 : empty);
+    writeAll(STDOUT_FILENO, out.data, out.length);
+    free(out.data);
+    return true;
+}
+
+// Append a string quoted for the given shell: inside double quotes for bash, single quotes for
+// zsh and fish (the quotes themselves are not appended)
+static void bufferShellQuoted(CL_Buffer* buffer, const char* string, CL_Shell shell) {
+    for (const char* c = string; *c; c++) {
+        if (shell == CL_SHELL_BASH && (*c == '"' || *c == '\\' || *c == '$' || *c == '`')) {
+            bufferAppend(buffer, "\\", 1);
+        } else if (shell == CL_SHELL_ZSH && *c == '\'') {
+            bufferString(buffer, "'\\'");
+        } else if (shell == CL_SHELL_FISH && (*c == '\'' || *c == '\\')) {
+            bufferAppend(buffer, "\\", 1);
+        }
+        bufferAppend(buffer, c, 1);
+    }
+}
+
+// Append a string quoted for an _arguments spec of zsh (inside single quotes, where brackets,
+// colons, parentheses, spaces and backslashes are special to _arguments)
+static void bufferZshSpec(CL_Buffer* buffer, const char* string) {
+    for (const char* c = string; *c; c++) {
+        if (strchr("[]:() \\", *c)) {
+            bufferAppend(buffer, "\\", 1);
+        }
+        if (*c == '\'') {
+            bufferString(buffer, "'\\'");
+        }
+        bufferAppend(buffer, c, 1);
+    }
+}
+
+// Append the choices of an option separated by spaces
+static void bufferChoices(CL_Buffer* buffer, const CL_Option* option, CL_Shell shell) {
+    for (int o = 0; option->strOptions.oneOf[o]; o++) {
+        if (o > 0) {
+            bufferAppend(buffer, " ", 1);
+        }
+        if (shell == CL_SHELL_ZSH) {
+            bufferZshSpec(buffer, option->strOptions.oneOf[o]);
+        } else {
+            bufferShellQuoted(buffer, option->strOptions.oneOf[o], shell);
+        }
+    }
+}
+
+// Append a program name to a comment line of a script, with control characters (eg a newline
+// that would end the comment) replaced by spaces. For the #compdef line of zsh, which is split at
+// spaces without unquoting, spaces are replaced by underscores too
+static void bufferCommented(CL_Buffer* buffer, const char* progname, bool word) {
+    for (const char* c = progname; *c; c++) {
+        bool control = (unsigned char)*c < ' ' || *c == 0x7F;
+        bufferAppend(buffer, word && (control || *c == ' ') ? "_" : control ? " " : c, 1);
+    }
+}
+
+// Append the name of the shell function of a program (its name with anything but letters and
+// digits replaced by underscores)
+static void bufferFunctionName(CL_Buffer* buffer, const char* progname) {
+    bufferString(buffer, "_");
+    for (const char* c = progname; *c; c++) {
+        bool alnum = (*c >= 'a' && *c <= 'z') || (*c >= 'A' && *c <= 'Z') || (*c >= '0' && *c <= '9');
+        bufferAppend(buffer, alnum ? c : "_", 1);
+    }
+    bufferString(buffer, "_complete");
+}
+
+// Render a bash completion script: flags, choices and subcommand names are completed from the
+// script, the words after a subcommand by the program's __complete mode
+static void renderBash(CL_Buffer* out, const CL_Option* schema, const char* progname, bool hasCommands) {
+    bufferString(out, "# bash completion for ");
+    bufferCommented(out, progname, false);
+    bufferString(out, " (generated by CLargs)\n");
+    bufferFunctionName(out, progname);
+    bufferString(out, "() {\n    local cur=\"${COMP_WORDS[COMP_CWORD]}\" prev=\"${COMP_WORDS[COMP_CWORD-1]}\" word\n");
+    if (hasCommands) {
+        bufferString(out, "    for word in \"${COMP_WORDS[@]:1:COMP_CWORD-1}\"; do\n        case \"$word\" in\n            ");
+        bool first = true;
+        for (size_t i = 0; schema[i].type != END; i++) {
+            if (schema[i].type == SUBCOMMAND) {
+                bufferString(out, first ? "\"" : "|\"");
+                bufferShellQuoted(out, schema[i].name, CL_SHELL_BASH);
+                bufferString(out, "\"");
+                first = false;
+            }
+        }
+        bufferString(out, ")\n                mapfile -t COMPREPLY < <(\"");
+        bufferShellQuoted(out, progname, CL_SHELL_BASH);
+        bufferString(out, "\" __complete \"${COMP_WORDS[@]:1:COMP_CWORD}\")\n                return;;\n        esac\n    done\n");
+    }
+
+    // The values of flags: choices, or the default completion (files)
+    bufferString(out, "    case \"$prev\" in\n");
+    for (size_t i = 0; schema[i].type != END; i++) {
+        if (!takesValue(&schema[i])) {
+            continue;
+        }
+        bufferString(out, "        ");
+        if (schema[i].abbr) {
+            char abbr[5] = {'"', '-', schema[i].abbr, '"', '|'};
+            bufferAppend(out, abbr, 5);
+        }
+        bufferString(out, "\"--");
+        bufferShellQuoted(out, schema[i].name, CL_SHELL_BASH);
+        bufferString(out, "\")");
+        if (hasChoices(&schema[i])) {
+            bufferString(out, "\n            COMPREPLY=($(compgen -W \"");
+            bufferChoices(out, &schema[i], CL_SHELL_BASH);
+            bufferString(out, "\" -- \"$cur\"))\n            return;;\n");
+        } else {
+            bufferString(out, " return;;\n");
+        }
+    }
+    bufferString(out, "    esac\n\n    case \"$cur\" in\n        -*) COMPREPLY=($(compgen -W \"");
+    bool first = true;
+    for (size_t i = 0; schema[i].type != END; i++) {
+        if (schema[i].type == SUBCOMMAND) {
+            continue;
+        }
+        bufferString(out, first ? "--" : " --");
+        bufferShellQuoted(out, schema[i].name, CL_SHELL_BASH);
+        if (schema[i].abbr) {
+            char abbr[4] = {' ', '-', schema[i].abbr, '\0'};
+            bufferString(out, abbr);
+        }
+        first = false;
+    }
+    bufferString(out, "\" -- \"$cur\"));;\n");
+    if (hasCommands) {
+        bufferString(out, "        *) COMPREPLY=($(compgen -W \"");
+        first = true;
+        for (size_t i = 0; schema[i].type != END; i++) {
+            if (schema[i].type == SUBCOMMAND) {
+                bufferString(out, first ? "" : " ");
+                bufferShellQuoted(out, schema[i].name, CL_SHELL_BASH);
+                first = false;
+            }
+        }
+        bufferString(out, "\" -- \"$cur\"));;\n");
+    }
+    bufferString(out, "    esac\n}\ncomplete -o default -F ");
+    bufferFunctionName(out, progname);
+    bufferString(out, " \"");
+    bufferShellQuoted(out, progname, CL_SHELL_BASH);
+    bufferString(out, "\"\n");
+}
+
+// Render a zsh completion script (an _arguments spec per option, the words after a subcommand
+// completed by the program's __complete mode)
+static void renderZsh(CL_Buffer* out, const CL_Option* schema, const char* progname, bool hasCommands) {
+    bufferString(out, "#compdef ");
+    bufferCommented(out, progname, true);
+    bufferString(out, "\n# zsh completion for ");
+    bufferCommented(out, progname, false);
+    bufferString(out, " (generated by CLargs)\n");
+    bufferFunctionName(out, progname);
+    bufferString(out, "() {\n    _arguments -s");
+    for (size_t i = 0; schema[i].type != END; i++) {
+        const CL_Option* option = &schema[i];
+        if (option->type == SUBCOMMAND) {
+            continue;
+        }
+        bool repeated = option->type == STRING_LIST || option->type == INT_LIST || option->type == DOUBLE_LIST;
+        bufferString(out, " \\\n        ");
+        if (repeated) {
+            bufferString(out, "'*'");
+        } else if (option->abbr) {
+            // The abbreviation and the name exclude each other
+            char abbr[3] = {'-', option->abbr, '\0'};
+            bufferString(out, "'(");
+            bufferString(out, abbr);
+            bufferString(out, " --");
+            bufferZshSpec(out, option->name);
+            bufferString(out, ")'");
+        }
+        if (option->abbr) {
+            char abbr[5] = {'{', '-', option->abbr, ',', '\0'};
+            bufferString(out, abbr);
+        }
+        bufferString(out, "'--");
+        bufferZshSpec(out, option->name);
+        if (option->abbr) {
+            bufferString(out, "'}'");
+        }
+        bufferString(out, "[");
+        bufferZshSpec(out, option->description ? option->description : "");
+        bufferString(out, "]");
+        if (takesValue(option)) {
+            bufferString(out, ":");
+            bufferZshSpec(out, option->name);
+            if (hasChoices(option)) {
+                bufferString(out, ":(");
+                bufferChoices(out, option, CL_SHELL_ZSH);
+                bufferString(out, ")");
+            } else {
+                bufferString(out, ":_default");
+            }
+        }
+        bufferString(out, "'");
+    }
+    if (hasCommands) {
+        bufferString(out, " \\\n        '1:command:(");
+        bool first = true;
+        for (size_t i = 0; schema[i].type != END; i++) {
+            if (schema[i].type == SUBCOMMAND) {
+                bufferString(out, first ? "" : " ");
+                bufferZshSpec(out, schema[i].name);
+                first = false;
+            }
+        }
+        // After the subcommand, words holds the subcommand and its arguments
+        bufferString(out, ")' \\\n        '*::arguments:->arguments'\n");
+        bufferString(out, "    [[ $state == arguments ]] && compadd -- ${(f)\"$('");
+        bufferShellQuoted(out, progname, CL_SHELL_ZSH);
+        bufferString(out, "' __complete \"${(@)words[1,CURRENT]}\")\"}\n");
+    } else {
+        bufferString(out, " \\\n        '*:value:_default'\n");
+    }
+    bufferString(out, "}\n");
+    bufferFunctionName(out, progname);
+    bufferString(out, " \"$@\"\n");
+}
+
+// Render a fish completion script (a complete command per option, the words after a subcommand
+// completed by the program's __complete mode)
+static void renderFish(CL_Buffer* out, const CL_Option* schema, const char* progname, bool hasCommands) {
+    bufferString(out, "# fish completion for ");
+    bufferCommented(out, progname, false);
+    bufferString(out, " (generated by CLargs)\n");
+    for (size_t i = 0; schema[i].type != END; i++) {
+        const CL_Option* option = &schema[i];
+        bufferString(out, "complete -c '");
+        bufferShellQuoted(out, progname, CL_SHELL_FISH);
+        bufferString(out, "'");
+        if (hasCommands) {
+            bufferString(out, " -n __fish_use_subcommand");
+        }
+        if (option->type == SUBCOMMAND) {
+            bufferString(out, " -f -a '");
+            bufferShellQuoted(out, option->name, CL_SHELL_FISH);
+            bufferString(out, "'");
+        } else {
+            if (option->abbr) {
+                char abbr[2] = {option->abbr, '\0'};
+                bufferString(out, " -s '");
+                bufferShellQuoted(out, abbr, CL_SHELL_FISH);
+                bufferString(out, "'");
+            }
+            bufferString(out, " -l '");
+            bufferShellQuoted(out, option->name, CL_SHELL_FISH);
+            bufferString(out, "'");
+            if (hasChoices(option)) {
+                bufferString(out, " -x -a '");
+                bufferChoices(out, option, CL_SHELL_FISH);
+                bufferString(out, "'");
+            } else if (takesValue(option)) {
+                bufferString(out, " -r");
+            }
+        }
+        if (option->description) {
+            bufferString(out, " -d '");
+            bufferShellQuoted(out, option->description, CL_SHELL_FISH);
+            bufferString(out, "'");
+        }
+        bufferString(out, "\n");
+    }
+    if (hasCommands) {
+        bufferString(out, "complete -c '");
+        bufferShellQuoted(out, progname, CL_SHELL_FISH);
+        // The command substitution is itself in single quotes, so the quoted name is quoted again
+        CL_Buffer quoted = {0};
+        bufferString(&quoted, "'");
+        bufferShellQuoted(&quoted, progname, CL_SHELL_FISH);
+        bufferString(&quoted, "'");
+        bufferString(out, "' -n 'not __fish_use_subcommand' -f -a '(");
+        bufferShellQuoted(out, quoted.data, CL_SHELL_FISH);
+        bufferString(out, " __complete (commandline -opc)[2..-1] (commandline -ct))'\n");
+        free(quoted.data);
+    }
+}
+
+char* CL_completionScript(const CL_Schema schema, const char* progname, CL_Shell shell) {
+    bool hasCommands = false;
+    for (size_t i = 0; schema[i].type != END; i++) {
+        hasCommands |= schema[i].type == SUBCOMMAND;
+    }
+    CL_Buffer out = {0};
+    bufferReserve(&out, 0);
+    switch (shell) {
+        case CL_SHELL_BASH:
+            renderBash(&out, schema, progname, hasCommands);
+            break;
+        case CL_SHELL_ZSH:
+            renderZsh(&out, schema, progname, hasCommands);
+            break;
+        case CL_SHELL_FISH:
+            renderFish(&out, schema, progname, hasCommands);
+            break;
+    }
+    return out.data;
+}
+
+// CODE GENERATION
+
+// Append a string as a C string literal (quotes included)
+static void bufferCString(CL_Buffer* buffer, const char* string, size_t length) {
+    bufferAppend(buffer, "\"", 1);
+    for (size_t i = 0; i < length; i++) {
+        unsigned char c = (unsigned char)string[i];
+        if (c == '"' || c == '\\') {
+            bufferAppend(buffer, "\\", 1);
+            bufferAppend(buffer, string + i, 1);
+        } else if (c < ' ' || c > '~' || c == '?') {
+            // Octal escapes (always 3 digits, so a following digit is not part of them)
+            char escape[5] = {'\\', '0' + (c >> 6), '0' + ((c >> 3) & 7), '0' + (c & 7), '\0'};
+            bufferString(buffer, escape);
+        } else {
+            bufferAppend(buffer, string + i, 1);
+        }
+    }
+    bufferAppend(buffer, "\"", 1);
+}
+
+// Append a case label for a character (its code, with the character as a comment if printable)
+static void bufferCase(CL_Buffer* buffer, size_t indent, char c) {
+    bufferPad(buffer, indent);
+    bufferString(buffer, "case ");
+    bufferInt(buffer, (unsigned char)c);
+    bufferAppend(buffer, ":", 1);
+    if (c > ' ' && c <= '~' && c != '\\') {
+        char comment[9] = {' ', ' ', '/', '/', ' ', '\'', c, '\'', '\0'};
+        bufferString(buffer, comment);
+    }
+    bufferAppend(buffer, "\n", 1);
+}
+
+// Append a double as a C constant that converts back to exactly the same value
+static void bufferCDouble(CL_Buffer* buffer, double value) {
+    if (isnan(value)) {
+        bufferString(buffer, "NAN");
+    } else if (isinf(value)) {
+        bufferString(buffer, value < 0 ? "-INFINITY" : "INFINITY");
+    } else {
+        char digits[32];
+        snprintf(digits, sizeof(digits), "%.17g", value);
+        bufferString(buffer, digits);
+        // Keep it a double constant
+        if (!strpbrk(digits, ".e")) {
+            bufferString(buffer, ".0");
+        }
+    }
+}
+
+// Identifiers of the fields of the options: their names with anything but letters, digits and
+// underscores replaced by underscores, with an underscore appended to C keywords and names of the
+// other fields, and the option index appended to identifiers already taken by an earlier option
+static char** fieldNames(const CL_Option* schema, uint32_t option_count) {
+    static const char* const reserved[] = {
+        "auto", "bool", "break", "case", "char", "const", "continue", "default", "do", "double", "else", "enum", "extern", "float", "for", "goto", "if",
+        "inline", "int", "long", "register", "restrict", "return", "short", "signed", "sizeof", "static", "struct", "switch", "typedef", "union",
+        "unsigned", "void", "volatile", "while", "path", "values", "value_count", "error_count", "first_error", "help_requested", "block", NULL,
+    };
+    char** fields = malloc(option_count * sizeof(char*));
+    if (!fields && option_count) {
+        perror("[CLargs] malloc");
+        abort();
+    }
+    for (uint32_t i = 0; i < option_count; i++) {
+        CL_Buffer field = {0};
+        const char* name = schema[i].name;
+        if (*name >= '0' && *name <= '9') {
+            bufferAppend(&field, "_", 1);
+        }
+        for (const char* c = name; *c; c++) {
+            bool valid = (*c >= 'a' && *c <= 'z') || (*c >= 'A' && *c <= 'Z') || (*c >= '0' && *c <= '9') || *c == '_';
+            bufferAppend(&field, valid ? c : "_", 1);
+        }
+        for (const char* const* word = reserved; *word; word++) {
+            if (strcmp(field.data, *word) == 0) {
+                bufferAppend(&field, "_", 1);
+                break;
+            }
+        }
+        for (uint32_t other = 0; other < i; other++) {
+            if (strcmp(fields[other], field.data) == 0) {
+                bufferAppend(&field, "_", 1);
+                bufferInt(&field, (int32_t)i);
+                break;
+            }
+        }
+        fields[i] = field.data;
+    }
+    return fields;
+}
+
+// Append "<prefix>_<name>"
+static inline void bufferPrefixed(CL_Buffer* buffer, const char* prefix, const char* name) {
+    bufferString(buffer, prefix);
+    bufferAppend(buffer, "_", 1);
+    bufferString(buffer, name);
+}
+
+// Append an "args-><field>" lvalue with the given indentation
+static void bufferArgsField(CL_Buffer* buffer, size_t indent, const char* field) {
+    bufferPad(buffer, indent);
+    bufferString(buffer, "args->");
+    bufferString(buffer, field);
+}
+
+// Append the state of the long name DFA for the sorted names [low, high), which share their
+// first depth characters. Names with a single candidate left end in one comparison
+static void renderNameState(CL_Buffer* out, const CL_Compiled* compiled, uint32_t low, uint32_t high, size_t depth) {
+    const CL_SortedName* sorted = compiled->sorted;
+    // The label of a state is its first name and depth (the initial state is never jumped to)
+    if (depth > 0) {
+        bufferString(out, "s");
+        bufferInt(out, (int32_t)low);
+        bufferAppend(out, "_", 1);
+        bufferInt(out, (int32_t)depth);
+        bufferString(out, ":\n");
+    }
+    if (high - low == 1 && depth > 0) {
+        // A prefix of the rest of the name
+        const char* rest = sorted[low].name + depth;
+        bufferString(out, "    return n - i <= ");
+        bufferInt(out, (int32_t)strlen(rest));
+        bufferString(out, " && memcmp(s + i, ");
+        bufferCString(out, rest, strlen(rest));
+        bufferString(out, ", n - i) == 0 ? ");
+        bufferInt(out, findLongOption(compiled, sorted[low].name));
+        bufferString(out, " : -1;\n");
+        return;
+    }
+    // At the end of the name: an exact name (sorted first), else the only name left, else ambiguous
+    bufferString(out, "    if (i == n) {\n        return ");
+    if (depth == 0) {
+        bufferString(out, "-1");
+    } else if (sorted[low].name[depth] == '\0') {
+        bufferInt(out, findLongOption(compiled, sorted[low].name));
+    } else {
+        bufferString(out, "-2");
+    }
+    bufferString(out, ";\n    }\n    switch (s[i++]) {\n");
+    uint32_t first = sorted[low].name[depth] == '\0' ? low + 1 : low;
+    for (uint32_t group = first; group < high;) {
+        uint32_t end = group + 1;
+        while (end < high && sorted[end].name[depth] == sorted[group].name[depth]) {
+            end++;
+        }
+        bufferCase(out, 8, sorted[group].name[depth]);
+        bufferString(out, "            goto s");
+        bufferInt(out, (int32_t)group);
+        bufferAppend(out, "_", 1);
+        bufferInt(out, (int32_t)depth + 1);
+        bufferString(out, ";\n");
+        group = end;
+    }
+    bufferString(out, "        default:\n            return -1;\n    }\n");
+    for (uint32_t group = first; group < high;) {
+        uint32_t end = group + 1;
+        while (end < high && sorted[end].name[depth] == sorted[group].name[depth]) {
+            end++;
+        }
+        renderNameState(out, compiled, group, end, depth + 1);
+        group = end;
+    }
+}
+
+// Append the choices of option i with choices as a table, and a function matching a value to
+// them: by a switch on its length for whole choices, then by a scan for a unique prefix if the
+// option allows prefixes
+static void renderChoiceMatcher(CL_Buffer* out, const CL_Option* option, uint32_t i, const char* prefix) {
+    bool nocase = option->strOptions.match & CL_MATCH_NOCASE;
+    const char* const* oneOf = option->strOptions.oneOf;
+    bufferString(out, "static const char* const ");
+    bufferPrefixed(out, prefix, "choices");
+    bufferInt(out, (int32_t)i);
+    bufferString(out, "[] = {");
+    for (int o = 0; oneOf[o]; o++) {
+        bufferCString(out, oneOf[o], strlen(oneOf[o]));
+        bufferString(out, ", ");
+    }
+    bufferString(out, "NULL};\n\n// Index of the choice of --");
+    bufferString(out, option->name);
+    bufferString(out, " matching a value (-1 if none or several)\nstatic int32_t ");
+    bufferPrefixed(out, prefix, "choice");
+    bufferInt(out, (int32_t)i);
+    bufferString(out, "(const char* value) {\n    size_t n = strlen(value);\n    switch (n) {\n");
+    // One case per choice length, testing the choices of that length in order
+    for (int o = 0; oneOf[o]; o++) {
+        size_t length = strlen(oneOf[o]);
+        bool seen = false;
+        for (int other = 0; other < o && !seen; other++) {
+            seen = strlen(oneOf[other]) == length;
+        }
+        if (seen) {
+            continue;
+        }
+        bufferString(out, "        case ");
+        bufferInt(out, (int32_t)length);
+        bufferString(out, ":\n");
+        for (int same = o; oneOf[same]; same++) {
+            if (strlen(oneOf[same]) != length) {
+                continue;
+            }
+            if (nocase) {
+                bufferString(out, "            if (");
+                bufferPrefixed(out, prefix, "sameNoCase(value, ");
+            } else {
+                bufferString(out, "            if (memcmp(value, ");
+            }
+            bufferCString(out, oneOf[same], length);
+            bufferString(out, nocase ? ", n)) {\n                return " : ", n) == 0) {\n                return ");
+            bufferInt(out, same);
+            bufferString(out, ";\n            }\n");
+        }
+        bufferString(out, "            break;\n");
+    }
+    bufferString(out, "    }\n");
+    if (!(option->strOptions.match & CL_MATCH_PREFIX)) {
+        bufferString(out, "    return -1;\n}\n\n");
+        return;
+    }
+    bufferString(out, "    int32_t found = -1;\n    for (int32_t o = 0; ");
+    bufferPrefixed(out, prefix, "choices");
+    bufferInt(out, (int32_t)i);
+    bufferString(out, "[o]; o++) {\n        if (");
+    if (nocase) {
+        bufferPrefixed(out, prefix, "sameNoCase(");
+    } else {
+        bufferString(out, "strncmp(");
+    }
+    bufferPrefixed(out, prefix, "choices");
+    bufferInt(out, (int32_t)i);
+    bufferString(out, nocase ? "[o], value, n)) {\n" : "[o], value, n) == 0) {\n");
+    bufferString(out, "            if (found >= 0) {\n                return -1;\n            }\n            found = o;\n        }\n    }\n    return found;\n}\n\n");
+}
+
+// Append the conversion of the value of option i, which takes one (setting error, or the option)
+static void renderConversion(CL_Buffer* out, const CL_Option* option, uint32_t i, const char* field, const char* prefix) {
+    bool list = isListType(option->type);
+    switch (option->type) {
+        case STRING:
+        case STRING_LIST:
+            if (option->type == STRING_LIST || !option->strOptions.optional) {
+                bufferString(out, "                if (!*value) {\n                    error = CL_ERR_MISSING_VALUE;\n                    break;\n                }\n");
+            }
+            if (hasChoices(option)) {
+                // The value is the choice matched, with its index
+                bufferString(out, "                if ((choice = ");
+                bufferPrefixed(out, prefix, "choice");
+                bufferInt(out, (int32_t)i);
+                bufferString(out, "(value)) < 0) {\n                    error = CL_ERR_INVALID_CHOICE;\n                    break;\n                }\n");
+                bufferArgsField(out, 16, field);
+                bufferString(out, ".string = (char*)");
+                bufferPrefixed(out, prefix, "choices");
+                bufferInt(out, (int32_t)i);
+                bufferString(out, "[choice];\n");
+                bufferArgsField(out, 16, field);
+                bufferString(out, ".index = choice;\n");
+                break;
+            }
+            bufferArgsField(out, 16, field);
+            bufferString(out, list ? ".items[" : " = value;\n");
+            break;
+        case INT:
+        case INT_LIST:
+            bufferString(out, "                if ((error = ");
+            bufferPrefixed(out, prefix, "toInt(value, &integer))) {\n                    break;\n                }\n");
+            if (option->intOptions.minValue != 0 || option->intOptions.maxValue != 0) {
+                bufferString(out, "                if (integer < ");
+                bufferInt(out, option->intOptions.minValue);
+                bufferString(out, " || integer > ");
+                bufferInt(out, option->intOptions.maxValue);
+                bufferString(out, ") {\n                    error = CL_ERR_OUT_OF_RANGE;\n                    break;\n                }\n");
+            }
+            bufferArgsField(out, 16, field);
+            bufferString(out, list ? ".items[" : " = integer;\n");
+            break;
+        case DOUBLE:
+        case DOUBLE_LIST:
+            bufferString(out, "                if ((error = ");
+            bufferPrefixed(out, prefix, "toDouble(value, &number))) {\n                    break;\n                }\n");
+            if (option->doubleOptions.minValue != 0.0 || option->doubleOptions.maxValue != 0.0) {
+                bufferString(out, "                if (number < ");
+                bufferCDouble(out, option->doubleOptions.minValue);
+                bufferString(out, " || number > ");
+                bufferCDouble(out, option->doubleOptions.maxValue);
+                bufferString(out, ") {\n                    error = CL_ERR_OUT_OF_RANGE;\n                    break;\n                }\n");
+            }
+            bufferArgsField(out, 16, field);
+            bufferString(out, list ? ".items[" : " = number;\n");
+            break;
+        case END:
+        case HELP:
+        case BOOLEAN:
+        case SUBCOMMAND:
+            break;
+    }
+    if (list) {
+        bufferString(out, "args->");
+        bufferString(out, field);
+        bufferString(out, ".count++] = ");
+        bufferString(out, option->type == STRING_LIST ? "value;\n" : option->type == INT_LIST ? "integer;\n" : "number;\n");
+    }
+}
+
+// Append "set[<word>] |= <bit>;" for a term of the constraints, with the given indentation
+static void bufferSetTerm(CL_Buffer* out, size_t indent, uint32_t term) {
+    bufferPad(out, indent);
+    bufferString(out, "set[");
+    bufferInt(out, (int32_t)(term >> 6));
+    bufferString(out, "] |= 1ull << ");
+    bufferInt(out, (int32_t)(term & 63));
+    bufferString(out, ";\n");
+}
+
+// Append the loop over the terms of a word of a constraint's mask that are set (or missing),
+// with the option of each term in "option"
+static void renderTermLoop(CL_Buffer* out, uint32_t w, uint64_t mask, bool missing) {
+    char hex[24];
+    snprintf(hex, sizeof(hex), "0x%llxull", (unsigned long long)mask);
+    bufferString(out, "        for (uint64_t terms = ");
+    bufferString(out, missing ? "~set[" : "set[");
+    bufferInt(out, (int32_t)w);
+    bufferString(out, "] & ");
+    bufferString(out, hex);
+    bufferString(out, "; terms; terms &= terms - 1) {\n            int32_t option = options[");
+    bufferInt(out, (int32_t)(w * 64));
+    bufferString(out, " + __builtin_ctzll(terms)];\n");
+}
+
+// Append the check of the constraints of a schema (as done by checkConstraints), over the bits
+// of the options set while parsing
+static void renderConstraints(CL_Buffer* out, const CL_Compiled* compiled, char** fields, const char* prefix) {
+    static const char* const kinds[] = {
+        [CL_CONSTRAINT_REQUIRES] = "CL_REQUIRES",
+        [CL_CONSTRAINT_CONFLICTS] = "CL_CONFLICTS",
+        [CL_CONSTRAINT_EXACTLY_ONE] = "CL_EXACTLY_ONE_OF",
+        [CL_CONSTRAINT_AT_LEAST_ONE] = "CL_AT_LEAST_ONE_OF",
+    };
+    bufferString(out, "static void ");
+    bufferPrefixed(out, prefix, "constraintError(");
+    bufferPrefixed(out, prefix, "Args* args, CL_ErrorCode code, CL_FlagId id, CL_FlagId related) {\n"
+                                "    if (args->error_count++ == 0) {\n"
+                                "        args->first_error = (CL_Error){.argIndex = -1, .id = id, .code = code, .message = CL_errorMessage(code), "
+                                ".suggestion = CL_NO_FLAG, .related = related};\n    }\n}\n\n");
+    bufferString(out, "// Check the constraints of the schema over the options set explicitly (a bit per option, then\n"
+                      "// one per choice term)\nstatic void ");
+    bufferPrefixed(out, prefix, "checkConstraints(");
+    bufferPrefixed(out, prefix, "Args* args, uint64_t* set) {\n    // Option of each term\n    static const int32_t options[] = {");
+    for (uint32_t t = 0; t < compiled->option_count + compiled->choice_term_count; t++) {
+        bufferString(out, t ? ", " : "");
+        bufferInt(out, termOption(compiled, t));
+    }
+    bufferString(out, "};\n");
+    for (uint32_t t = 0; t < compiled->choice_term_count; t++) {
+        const CL_ChoiceTerm* term = &compiled->choice_terms[t];
+        bufferString(out, "    if ((set[");
+        bufferInt(out, term->option >> 6);
+        bufferString(out, "] >> ");
+        bufferInt(out, term->option & 63);
+        bufferString(out, " & 1) && args->");
+        bufferString(out, fields[term->option]);
+        bufferString(out, ".index == ");
+        bufferInt(out, term->choice);
+        bufferString(out, ") {\n");
+        bufferSetTerm(out, 8, compiled->option_count + t);
+        bufferString(out, "    }\n");
+    }
+    for (uint32_t c = 0; c < compiled->constraint_count; c++) {
+        const CL_CompiledConstraint* constraint = &compiled->constraints[c];
+        bufferString(out, "    // ");
+        bufferString(out, kinds[constraint->kind]);
+        for (const char* const* name = constraint->source->options; *name; name++) {
+            bufferString(out, name == constraint->source->options ? ": " : ", ");
+            bufferString(out, *name);
+        }
+        bufferString(out, "\n");
+        bool bySubject = constraint->kind == CL_CONSTRAINT_REQUIRES || constraint->kind == CL_CONSTRAINT_CONFLICTS;
+        if (bySubject) {
+            bufferString(out, "    if (set[");
+            bufferInt(out, (int32_t)(constraint->subject >> 6));
+            bufferString(out, "] >> ");
+            bufferInt(out, (int32_t)(constraint->subject & 63));
+            bufferString(out, " & 1) {\n");
+        } else {
+            bufferString(out, "    {\n        int32_t first = -1;\n");
+        }
+        for (uint32_t w = 0; w < compiled->term_words; w++) {
+            if (!constraint->mask[w]) {
+                continue;
+            }
+            renderTermLoop(out, w, constraint->mask[w], constraint->kind == CL_CONSTRAINT_REQUIRES);
+            if (bySubject) {
+                bufferString(out, "            ");
+                bufferPrefixed(out, prefix, constraint->kind == CL_CONSTRAINT_REQUIRES ? "constraintError(args, CL_ERR_MISSING_REQUIRED, "
+                                                                                         : "constraintError(args, CL_ERR_CONFLICTING_OPTION, ");
+                bufferInt(out, termOption(compiled, constraint->subject));
+                bufferString(out, ", option);\n        }\n");
+            } else if (constraint->kind == CL_CONSTRAINT_EXACTLY_ONE) {
+                bufferString(out, "            if (first < 0) {\n                first = option;\n            } else {\n                ");
+                bufferPrefixed(out, prefix, "constraintError(args, CL_ERR_CONFLICTING_OPTION, option, first);\n            }\n        }\n");
+            } else {
+                bufferString(out, "            first = option;\n        }\n");
+            }
+        }
+        if (!bySubject) {
+            bufferString(out, "        if (first < 0) {\n            ");
+            bufferPrefixed(out, prefix, "constraintError(args, CL_ERR_MISSING_ONE_OF, ");
+            bufferInt(out, termOption(compiled, constraint->subject));
+            bufferString(out, ", CL_NO_FLAG);\n        }\n");
+        }
+        bufferString(out, "    }\n");
+    }
+    bufferString(out, "}\n\n");
+}
+
+char* CL_generateParser(const CL_Schema schema, const char* prefix) {
+    CL_Compiled* compiled = CL_compileSchema(schema);
+    if (compiled->has_subcommands) {
+        CL_freeCompiled(compiled);
+        return NULL;
+    }
+    uint32_t option_count = compiled->option_count;
+    uint32_t list_count = 0;
+    char** fields = fieldNames(schema, option_count);
+    CL_Buffer out = {0};
+
+    bufferString(&out, "// Parser generated by CLargs from a schema (do not edit): the options are matched by code\n"
+                       "// specialized for the schema, with the same results and errors as CL_parseContext\n\n"
+                       "#include \"CLargs.h\"\n\n#include <math.h>\n#include <stdio.h>\n#include <stdlib.h>\n#include <string.h>\n\n");
+
+    // Result struct: one field per option
+    bufferString(&out, "typedef struct {\n    char* path;\n");
+    for (uint32_t i = 0; i < option_count; i++) {
+        const CL_Option* option = &schema[i];
+        switch (option->type) {
+            case HELP:
+            case BOOLEAN:
+                bufferString(&out, "    bool ");
+                break;
+            case STRING:
+                bufferString(&out, hasChoices(option) ? "    struct {\n        char* string;\n        int32_t index;\n    } " : "    char* ");
+                break;
+            case INT:
+                bufferString(&out, "    int32_t ");
+                break;
+            case DOUBLE:
+                bufferString(&out, "    double ");
+                break;
+            case STRING_LIST:
+                bufferString(&out, "    struct {\n        char** items;\n        uint32_t count;\n    } ");
+                break;
+            case INT_LIST:
+                bufferString(&out, "    struct {\n        int32_t* items;\n        uint32_t count;\n    } ");
+                break;
+            case DOUBLE_LIST:
+                bufferString(&out, "    struct {\n        double* items;\n        uint32_t count;\n    } ");
+                break;
+            case END:
+            case SUBCOMMAND:
+                break;
+        }
+        list_count += isListType(option->type);
+        bufferString(&out, fields[i]);
+        bufferString(&out, ";\n");
+    }
+    bufferString(&out, "    char** values;\n    uint32_t value_count;\n    uint32_t error_count;\n"
+                       "    // First error (code CL_ERR_NONE if there is none)\n    CL_Error first_error;\n    bool help_requested;\n"
+                       "    // Values and list items\n    void* block;\n} ");
+    bufferPrefixed(&out, prefix, "Args;\n\n");
+
+    // Long names
+    bufferString(&out, "// Option with the first n characters of s as its name or as the prefix of a single name (-1 if\n"
+                       "// none, -2 if several)\nstatic int32_t ");
+    bufferPrefixed(&out, prefix, "longOption(const char* s, size_t n) {\n    size_t i = 0;\n");
+    renderNameState(&out, compiled, 0, compiled->sorted_count, 0);
+    bufferString(&out, "}\n\n");
+
+    // Abbreviations
+    bufferString(&out, "// Option with an abbreviation (-1 if none)\nstatic int32_t ");
+    bufferPrefixed(&out, prefix, "shortOption(char c) {\n    switch (c) {\n");
+    for (int c = 1; c < 256; c++) {
+        if (compiled->abbr_index[c] >= 0) {
+            bufferCase(&out, 8, (char)c);
+            bufferString(&out, "            return ");
+            bufferInt(&out, compiled->abbr_index[c]);
+            bufferString(&out, ";\n");
+        }
+    }
+    bufferString(&out, "        default:\n            return -1;\n    }\n}\n\n");
+
+    // Value conversions, as done by CL_parse
+    bufferString(&out, "static inline CL_ErrorCode ");
+    bufferPrefixed(&out, prefix, "toInt(const char* value, int32_t* out) {\n"
+                                 "    if (!*value) {\n        return CL_ERR_MISSING_VALUE;\n    }\n    int64_t integer;\n"
+                                 "    CL_NumResult status = CL_strToInt64(value, &integer);\n"
+                                 "    if (status == CL_NUM_OVERFLOW || (status == CL_NUM_OK && (integer < INT32_MIN || integer > INT32_MAX))) {\n"
+                                 "        return CL_ERR_NUMBER_TOO_LARGE;\n    }\n    if (status != CL_NUM_OK) {\n        return CL_ERR_INVALID_NUMBER;\n    }\n"
+                                 "    *out = (int32_t)integer;\n    return CL_ERR_NONE;\n}\n\n");
+    bufferString(&out, "static inline CL_ErrorCode ");
+    bufferPrefixed(&out, prefix, "toDouble(const char* value, double* out) {\n"
+                                 "    if (!*value) {\n        return CL_ERR_MISSING_VALUE;\n    }\n"
+                                 "    CL_NumResult status = CL_strToDouble(value, out);\n"
+                                 "    if (status == CL_NUM_OVERFLOW) {\n        return CL_ERR_NUMBER_TOO_LARGE;\n    }\n"
+                                 "    return status == CL_NUM_OK ? CL_ERR_NONE : CL_ERR_INVALID_NUMBER;\n}\n\n");
+    bool hasChoiceOptions = false;
+    bool hasNoCase = false;
+    for (uint32_t i = 0; i < option_count; i++) {
+        hasChoiceOptions |= hasChoices(&schema[i]);
+        hasNoCase |= hasChoices(&schema[i]) && (schema[i].strOptions.match & CL_MATCH_NOCASE);
+    }
+    if (hasNoCase) {
+        bufferString(&out, "// Whether the first n characters of a and b are the same, ignoring the case of ASCII letters\nstatic inline bool ");
+        bufferPrefixed(&out, prefix, "sameNoCase(const char* a, const char* b, size_t n) {\n"
+                                     "    for (size_t i = 0; i < n; i++) {\n"
+                                     "        unsigned char x = a[i] >= 'A' && a[i] <= 'Z' ? a[i] + ('a' - 'A') : a[i];\n"
+                                     "        unsigned char y = b[i] >= 'A' && b[i] <= 'Z' ? b[i] + ('a' - 'A') : b[i];\n"
+                                     "        if (x != y) {\n            return false;\n        }\n    }\n    return true;\n}\n\n");
+    }
+    for (uint32_t i = 0; i < option_count; i++) {
+        if (hasChoices(&schema[i])) {
+            renderChoiceMatcher(&out, &schema[i], i, prefix);
+        }
+    }
+
+    // Errors and values
+    bufferString(&out, "static void ");
+    bufferPrefixed(&out, prefix, "error(");
+    bufferPrefixed(&out, prefix, "Args* args, CL_ErrorCode code, int argIndex, int offset, CL_FlagId id) {\n"
+                                 "    if (args->error_count++ == 0) {\n"
+                                 "        args->first_error = (CL_Error){.argIndex = argIndex, .offset = offset, .id = id, .code = code, .message = "
+                                 "CL_errorMessage(code), .suggestion = CL_NO_FLAG, .related = CL_NO_FLAG};\n    }\n}\n\n");
+    bool hasConstraints = compiled->constraint_count > 0;
+    if (hasConstraints) {
+        renderConstraints(&out, compiled, fields, prefix);
+    }
+    bufferString(&out, "// Value of the flag at argv[*a]: the next argument unless it is a long flag (\"\" otherwise), or NULL\n"
+                       "// if it is a response file\nstatic char* ");
+    bufferPrefixed(&out, prefix, "nextValue(int argc, char* argv[], int* a) {\n"
+                                 "    if (*a + 1 >= argc || (argv[*a + 1][0] == '-' && argv[*a + 1][1] == '-')) {\n        return \"\";\n    }\n"
+                                 "    if (argv[*a + 1][0] == '@' && argv[*a + 1][1] != '\\0') {\n        return NULL;\n    }\n"
+                                 "    return argv[++*a];\n}\n\n");
+
+    // Parser
+    bufferString(&out, "// Parse the arguments, returning false (with nothing to free) if they include response files,\n"
+                       "// which only CL_parse reads. Errors are counted, and parsing stops at the help option\nbool ");
+    bufferPrefixed(&out, prefix, "parse(int argc, char* argv[], ");
+    bufferPrefixed(&out, prefix, "Args* args) {\n    size_t cap = argc > 1 ? (size_t)argc - 1 : 0;\n    *args = (");
+    bufferPrefixed(&out, prefix, "Args){\n        .path = argc > 0 ? argv[0] : \"\",\n");
+    for (uint32_t i = 0; i < option_count; i++) {
+        const CL_Option* option = &schema[i];
+        if (option->type == STRING && (hasChoices(option) || option->strOptions.defaultValue)) {
+            const char* value = hasChoices(option) ? option->strOptions.oneOf[0] : option->strOptions.defaultValue;
+            bufferString(&out, "        .");
+            bufferString(&out, fields[i]);
+            bufferString(&out, hasChoices(option) ? ".string = " : " = ");
+            bufferCString(&out, value, strlen(value));
+            bufferString(&out, ",\n");
+        } else if (option->type == INT && option->intOptions.defaultValue) {
+            bufferString(&out, "        .");
+            bufferString(&out, fields[i]);
+            bufferString(&out, " = ");
+            bufferInt(&out, option->intOptions.defaultValue);
+            bufferString(&out, ",\n");
+        } else if (option->type == DOUBLE && option->doubleOptions.defaultValue != 0.0) {
+            bufferString(&out, "        .");
+            bufferString(&out, fields[i]);
+            bufferString(&out, " = ");
+            bufferCDouble(&out, option->doubleOptions.defaultValue);
+            bufferString(&out, ",\n");
+        }
+    }
+    bufferString(&out, "        .first_error = {.id = CL_NO_FLAG, .suggestion = CL_NO_FLAG, .related = CL_NO_FLAG},\n    };\n");
+    if (hasConstraints) {
+        bufferString(&out, "    // Options set explicitly, and the choice terms of the constraints\n    uint64_t set[");
+        bufferInt(&out, (int32_t)compiled->term_words);
+        bufferString(&out, "] = {0};\n");
+    }
+    bufferString(&out, "    // The values and the items of each list (every item fits in 8 bytes)\n    char* block = malloc((");
+    bufferInt(&out, (int32_t)list_count);
+    bufferString(&out, " + 1) * cap * 8 + 1);\n    if (!block) {\n        perror(\"[CLargs] malloc\");\n        abort();\n    }\n"
+                       "    args->block = block;\n    args->values = (char**)block;\n");
+    for (uint32_t i = 0, list = 1; i < option_count; i++) {
+        if (isListType(schema[i].type)) {
+            bufferArgsField(&out, 4, fields[i]);
+            bufferString(&out, ".items = (void*)(block + ");
+            bufferInt(&out, (int32_t)list++);
+            bufferString(&out, " * cap * 8);\n");
+        }
+    }
+
+    bufferString(&out, "\n    for (int a = 1; a < argc; a++) {\n        char* arg = argv[a];\n"
+                       "        if (arg[0] == '@' && arg[1] != '\\0') {\n            goto fallback;\n        }\n"
+                       "        if (arg[0] != '-' || arg[1] == '\\0') {\n            args->values[args->value_count++] = arg;\n            continue;\n        }\n"
+                       "        int32_t id;\n        char* inline_value = NULL;\n        if (arg[1] != '-') {\n"
+                       "            // Grouped short flags, which must be boolean\n            if (arg[2] != '\\0') {\n"
+                       "                for (char* c = arg + 1; *c; c++) {\n                    switch (*c) {\n");
+    for (int c = 1; c < 256; c++) {
+        int32_t i = compiled->abbr_index[c];
+        if (i < 0) {
+            continue;
+        }
+        bufferCase(&out, 24, (char)c);
+        if (schema[i].type == BOOLEAN) {
+            bufferArgsField(&out, 28, fields[i]);
+            bufferString(&out, " = true;\n");
+            if (hasConstraints) {
+                bufferSetTerm(&out, 28, i);
+            }
+            bufferString(&out, "                            break;\n");
+        } else {
+            bufferString(&out, "                            ");
+            bufferPrefixed(&out, prefix, "error(args, CL_ERR_GROUPED_NOT_BOOLEAN, a, (int)(c - arg), ");
+            bufferInt(&out, i);
+            bufferString(&out, ");\n                            break;\n");
+        }
+    }
+    bufferString(&out, "                        default:\n                            break;\n                    }\n                }\n                continue;\n            }\n"
+                       "            id = ");
+    bufferPrefixed(&out, prefix, "shortOption(arg[1]);\n        } else {\n            size_t n = 0;\n"
+                                 "            while (arg[2 + n] != '\\0' && arg[2 + n] != '=') {\n                n++;\n            }\n"
+                                 "            if (arg[2 + n] == '=') {\n                inline_value = arg + 3 + n;\n            }\n            id = ");
+    bufferPrefixed(&out, prefix, "longOption(arg + 2, n);\n            if (id == -2) {\n                ");
+    bufferPrefixed(&out, prefix, "error(args, CL_ERR_AMBIGUOUS_OPTION, a, 0, CL_NO_FLAG);\n                continue;\n            }\n        }\n"
+                                 "        if (id < 0) {\n            ");
+    bufferPrefixed(&out, prefix, "error(args, CL_ERR_UNKNOWN_OPTION, a, 0, CL_NO_FLAG);\n            continue;\n        }\n\n"
+                                 "        int flag = a;\n        char* value = inline_value;\n");
+    // Converted numbers (only declared if the schema has numbers)
+    bool hasInts = false;
+    bool hasDoubles = false;
+    for (uint32_t i = 0; i < option_count; i++) {
+        hasInts |= schema[i].type == INT || schema[i].type == INT_LIST;
+        hasDoubles |= schema[i].type == DOUBLE || schema[i].type == DOUBLE_LIST;
+    }
+    bufferString(&out, hasInts ? "        int32_t integer;\n" : "");
+    bufferString(&out, hasDoubles ? "        double number;\n" : "");
+    bufferString(&out, hasChoiceOptions ? "        int32_t choice;\n" : "");
+    bufferString(&out, "        CL_ErrorCode error = CL_ERR_NONE;\n        switch (id) {\n");
+    for (uint32_t i = 0; i < option_count; i++) {
+        const CL_Option* option = &schema[i];
+        bufferString(&out, "            case ");
+        bufferInt(&out, (int32_t)i);
+        bufferString(&out, ":  // --");
+        bufferString(&out, option->name);
+        bufferString(&out, "\n");
+        if (takesValue(option)) {
+            bufferString(&out, "                if (!value && !(value = ");
+            bufferPrefixed(&out, prefix, "nextValue(argc, argv, &a))) {\n                    goto fallback;\n                }\n");
+            renderConversion(&out, option, i, fields[i], prefix);
+            bufferString(&out, "                break;\n");
+        } else {
+            bufferString(&out, "                if (value) {\n                    error = CL_ERR_UNEXPECTED_VALUE;\n                    break;\n                }\n");
+            bufferArgsField(&out, 16, fields[i]);
+            bufferString(&out, " = true;\n");
+            if (option->type == HELP) {
+                bufferString(&out, "                args->help_requested = true;\n                return true;\n");
+            } else {
+                bufferString(&out, "                break;\n");
+            }
+        }
+    }
+    bufferString(&out, "        }\n        if (error) {\n            ");
+    bufferPrefixed(&out, prefix, "error(args, error, flag, inline_value ? (int)(inline_value - arg) : 0, id);\n        }");
+    if (hasConstraints) {
+        bufferString(&out, " else {\n            set[id >> 6] |= 1ull << (id & 63);\n        }\n    }\n    ");
+        bufferPrefixed(&out, prefix, "checkConstraints(args, set);\n");
+    } else {
+        bufferString(&out, "\n    }\n");
+    }
+    bufferString(&out, "    return true;\n\nfallback:\n    free(block);\n    return false;\n}\n\n");
+
+    // Generic access, eg to compare with CL_parse
+    bufferString(&out, "// Value of an option by handle (as CL_flagAt would give it)\nCL_FlagValue ");
+    bufferPrefixed(&out, prefix, "value(const ");
+    bufferPrefixed(&out, prefix, "Args* args, CL_FlagId id) {\n    CL_FlagValue value = {0};\n    switch (id) {\n");
+    for (uint32_t i = 0; i < option_count; i++) {
+        static const char* const members[] = {
+            [HELP] = "boolean", [BOOLEAN] = "boolean", [STRING] = "string", [INT] = "integer", [DOUBLE] = "number",
+            [STRING_LIST] = "list.strings", [INT_LIST] = "list.integers", [DOUBLE_LIST] = "list.numbers",
+        };
+        bufferString(&out, "        case ");
+        bufferInt(&out, (int32_t)i);
+        bufferString(&out, ":\n            value.");
+        bufferString(&out, members[schema[i].type]);
+        bufferString(&out, " = args->");
+        bufferString(&out, fields[i]);
+        if (hasChoices(&schema[i])) {
+            bufferString(&out, ".string;\n            value.choice.index = args->");
+            bufferString(&out, fields[i]);
+            bufferString(&out, ".index");
+        }
+        if (isListType(schema[i].type)) {
+            bufferString(&out, ".items;\n            value.list.count = args->");
+            bufferString(&out, fields[i]);
+            bufferString(&out, ".count");
+        }
+        bufferString(&out, ";\n            break;\n");
+    }
+    bufferString(&out, "    }\n    return value;\n}\n\nvoid ");
+    bufferPrefixed(&out, prefix, "free(");
+    bufferPrefixed(&out, prefix, "Args* args) {\n    free(args->block);\n    args->block = NULL;\n}\n");
+
+    for (uint32_t i = 0; i < option_count; i++) {
+        free(fields[i]);
+    }
+    free(fields);
+    CL_freeCompiled(compiled);
+    return out.data;
+}
+
+// NUMBERS
+
+// Whether 8 bytes can be read as one little-endian word for the SWAR digit routines
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define CL_SWAR 1
+#else
+#define CL_SWAR 0
+#endif
+
+// Numbers shorter than this are copied on the stack to remove their separators for strtod
+#define FALLBACK_STACK_LENGTH 128
+
+static inline bool isDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+// Value of a digit in the given base (or a value >= base if it isn't one)
+static inline uint32_t digitValue(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    c |= 0x20;  // Lowercase
+    if (c >= 'a' && c <= 'z') {
+        return c - 'a' + 10;
+    }
+    return UINT32_MAX;
+}
+
+#if CL_SWAR
+// Check whether the 8 characters at str are all decimal digits and if so, store their value
+static inline bool eightDigits(const char* str, uint64_t* value) {
+    uint64_t word;
+    memcpy(&word, str, sizeof(word));
+    // Every byte must be 0x30..0x39: high nibble 3, and adding 6 must not carry into the high nibble
+    if ((((word & 0xF0F0F0F0F0F0F0F0ull) | (((word + 0x0606060606060606ull) & 0xF0F0F0F0F0F0F0F0ull) >> 4))) != 0x3333333333333333ull) {
+        return false;
+    }
+    // Combine the digits pairwise into 2, 4 then 8 digit numbers
+    word -= 0x3030303030303030ull;
+    word = (word * 10) + (word >> 8);
+    word = (((word & 0x000000FF000000FFull) * (100 + (1000000ull << 32))) + (((word >> 16) & 0x000000FF000000FFull) * (1 + (10000ull << 32)))) >> 32;
+    *value = word;
+    return true;
+}
+#endif
+
+CL_NumResult CL_strToInt64(const char* str, int64_t* out) {
+    const char* p = str;
+    bool negative = false;
+    if (*p == '-' || *p == '+') {
+        negative = *p++ == '-';
+    }
+    uint32_t base = 10;
+    if (p[0] == '0') {
+        switch (p[1] | 0x20) {
+            case 'x':
+                base = 16;
+                p += 2;
+                break;
+            case 'b':
+                base = 2;
+                p += 2;
+                break;
+            case 'o':
+                base = 8;
+                p += 2;
+                break;
+        }
+    }
+    if (*p == '\0') {
+        return CL_NUM_EMPTY;
+    }
+
+    // Magnitude limit of the result
+    uint64_t limit = negative ? (uint64_t)INT64_MAX + 1 : (uint64_t)INT64_MAX;
+    uint64_t value = 0;
+#if CL_SWAR
+    // Take runs of 8 decimal digits at once while the value can't overflow
+    if (base == 10) {
+        size_t length = strlen(p);
+        uint64_t eight;
+        while (length >= 8 && value < 100000000ull && eightDigits(p, &eight)) {
+            value = value * 100000000ull + eight;
+            p += 8;
+            length -= 8;
+        }
+    }
+#endif
+    for (; *p; p++) {
+        // Separators are only allowed between digits
+        if (*p == '_' && p != str && digitValue(p[-1]) < base && digitValue(p[1]) < base) {
+            continue;
+        }
+        uint32_t digit = digitValue(*p);
+        if (digit >= base) {
+            return CL_NUM_SYNTAX;
+        }
+        if (value > (limit - digit) / base) {
+            return CL_NUM_OVERFLOW;
+        }
+        value = value * base + digit;
+    }
+
+    *out = negative ? (int64_t)(0 - value) : (int64_t)value;
+    return CL_NUM_OK;
+}
+
+// C locale for strtod, created once
+static pthread_once_t cLocaleOnce = PTHREAD_ONCE_INIT;
+static locale_t cLocale;
+
+static void createCLocale(void) {
+    cLocale = newlocale(LC_ALL_MASK, "C", (locale_t)0);
+    if (!cLocale) {
+        perror("[CLargs] newlocale");
+        abort();
+    }
+}
+
+// Convert a valid number that doesn't fit the fast path with strtod in the C locale (set for
+// the calling thread only), after removing the digit separators
+static double slowStrToDouble(const char* str) {
+    pthread_once(&cLocaleOnce, createCLocale);
+    char stack[FALLBACK_STACK_LENGTH];
+    char* buffer = NULL;
+    if (strchr(str, '_')) {
+        size_t size = strlen(str) + 1;
+        buffer = size <= sizeof(stack) ? stack : malloc(size);
+        if (!buffer) {
+            perror("[CLargs] malloc");
+            abort();
+        }
+        size_t length = 0;
+        for (const char* p = str; *p; p++) {
+            if (*p != '_') {
+                buffer[length++] = *p;
+            }
+        }
+        buffer[length] = '\0';
+    }
+    locale_t previous = uselocale(cLocale);
+    double result = strtod(buffer ? buffer : str, NULL);
+    uselocale(previous);
+    if (buffer != stack) {
+        free(buffer);
+    }
+    return result;
+}
+
+CL_NumResult CL_strToDouble(const char* str, double* out) {
+    // Powers of 10 that are exactly representable as doubles
+    static const double powers[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+    const char* p = str;
+    bool negative = false;
+    if (*p == '-' || *p == '+') {
+        negative = *p++ == '-';
+    }
+    if (*p == '\0') {
+        return CL_NUM_EMPTY;
+    }
+    if (!isDigit(*p) && !(*p == '.' && isDigit(p[1]))) {
+        return CL_NUM_SYNTAX;
+    }
+
+    // Accumulate up to 19 significant digits, with the decimal exponent to apply to them
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int64_t exponent = 0;
+    bool truncated = false;
+    bool fraction = false;
+    while (*p == '0') {
+        p++;
+    }
+    for (;; p++) {
+        if (isDigit(*p)) {
+#if CL_SWAR
+            uint64_t eight;
+            if (digits <= 19 - 8 && (mantissa != 0 || *p != '0') && strnlen(p, 8) == 8 && eightDigits(p, &eight)) {
+                mantissa = mantissa * 100000000ull + eight;
+                digits += 8;
+                exponent -= fraction ? 8 : 0;
+                p += 7;
+                continue;
+            }
+#endif
+            if (mantissa == 0 && *p == '0') {
+                // Leading zeros of the fraction only move the exponent
+                exponent -= fraction;
+            } else if (digits < 19) {
+                mantissa = mantissa * 10 + (*p - '0');
+                digits++;
+                exponent -= fraction;
+            } else {
+                // Digits past the precision of the mantissa
+                exponent += !fraction;
+                truncated |= *p != '0';
+            }
+        } else if (*p == '_' && p != str && isDigit(p[-1]) && isDigit(p[1])) {
+            continue;
+        } else if (*p == '.' && !fraction) {
+            fraction = true;
+        } else {
+            break;
+        }
+    }
+    if (*p == 'e' || *p == 'E') {
+        p++;
+        bool negativeExponent = false;
+        if (*p == '-' || *p == '+') {
+            negativeExponent = *p++ == '-';
+        }
+        if (!isDigit(*p)) {
+            return CL_NUM_SYNTAX;
+        }
+        int64_t value = 0;
+        for (; isDigit(*p); p++) {
+            // Saturate, anything this large overflows or underflows anyway
+            if (value < 100000) {
+                value = value * 10 + (*p - '0');
+            }
+        }
+        exponent += negativeExponent ? -value : value;
+    }
+    if (*p != '\0') {
+        return CL_NUM_SYNTAX;
+    }
+
+    double result;
+    if (mantissa == 0) {
+        result = 0.0;
+    } else if (!truncated && mantissa <= (1ull << 53) && exponent >= -22 && exponent <= 22) {
+        // Exact mantissa and power of 10: a single correctly rounded operation (Clinger's fast path)
+        result = (double)mantissa;
+        result = exponent < 0 ? result / powers[-exponent] : result * powers[exponent];
+    } else {
+        result = slowStrToDouble(str + (str[0] == '-' || str[0] == '+'));
+    }
+    if (!isfinite(result)) {
+        return CL_NUM_OVERFLOW;
+    }
+    *out = negative ? -result : result;
+    return CL_NUM_OK;
+}
+
+// VALUE CONVERSION
+
+// Messages of the error codes
+static const char* const errorMessages[] = {
+    [CL_ERR_NONE] = "No error",
+    [CL_ERR_MISSING_VALUE] = "Expected value after flag",
+    [CL_ERR_INVALID_CHOICE] = "invalid option",
+    [CL_ERR_INVALID_NUMBER] = "Invalid number",
+    [CL_ERR_NUMBER_TOO_LARGE] = "Number too large",
+    [CL_ERR_OUT_OF_RANGE] = "Value out of range",
+    [CL_ERR_UNKNOWN_OPTION] = "Unknown option",
+    [CL_ERR_GROUPED_NOT_BOOLEAN] = "Grouped flag not a boolean option",
+    [CL_ERR_INVALID_BOOLEAN] = "Invalid boolean",
+    [CL_ERR_CONFIG_UNREADABLE] = "Cannot read config file",
+    [CL_ERR_AMBIGUOUS_OPTION] = "Ambiguous option",
+    [CL_ERR_UNEXPECTED_VALUE] = "Flag does not take a value",
+    [CL_ERR_MISSING_REQUIRED] = "Requires option",
+    [CL_ERR_CONFLICTING_OPTION] = "Conflicts with option",
+    [CL_ERR_MISSING_ONE_OF] = "Expected one of these options",
+};
+
+const char* CL_errorMessage(CL_ErrorCode code) {
+    if ((size_t)code >= sizeof(errorMessages) / sizeof(errorMessages[0])) {
+        return "Unknown error";
+    }
+    return errorMessages[code];
+}
+
+// Convert and validate the string value of an option taking a value (a single item for lists).
+// Returns the error code (CL_ERR_NONE if the value is valid)
+static CL_ErrorCode convertValue(const CL_Compiled* compiled, size_t i, char* string_value, CL_FlagValue* value) {
+    const CL_Option* option = &compiled->schema[i];
+    switch (option->type) {
+        case STRING_LIST:
+            if (string_value[0] == 0) {
+                return CL_ERR_MISSING_VALUE;
+            }
+            value->string = string_value;
+            return CL_ERR_NONE;
+        case STRING:
+            if (string_value[0] == 0 && !option->strOptions.optional) {
+                return CL_ERR_MISSING_VALUE;
+            }
+            // The value of a "one of" option is the choice it matches
+            if (compiled->hot[i].choices >= 0) {
+                int32_t index = findChoice(compiled, i, string_value);
+                if (index < 0) {
+                    return CL_ERR_INVALID_CHOICE;
+                }
+                value->choice.string = (char*)option->strOptions.oneOf[index];
+                value->choice.index = index;
+                return CL_ERR_NONE;
+            }
+            value->string = string_value;
+            return CL_ERR_NONE;
+        case INT:
+        case INT_LIST: {
+            if (string_value[0] == 0) {
+                return CL_ERR_MISSING_VALUE;
+            }
+            // Convert the actual number (in base 10, or 2/8/16 with a 0b/0o/0x prefix)
+            int64_t integer_value;
+            CL_NumResult status = CL_strToInt64(string_value, &integer_value);
+            if (status == CL_NUM_OVERFLOW || (status == CL_NUM_OK && (integer_value < INT32_MIN || integer_value > INT32_MAX))) {
+                return CL_ERR_NUMBER_TOO_LARGE;
+            }
+            if (status != CL_NUM_OK) {
+                return CL_ERR_INVALID_NUMBER;
+            }
+            // Check if it is out of the range provided by the schema
+            if (option->intOptions.minValue != 0 || option->intOptions.maxValue != 0) {
+                if (integer_value < option->intOptions.minValue || integer_value > option->intOptions.maxValue) {
+                    return CL_ERR_OUT_OF_RANGE;
+                }
+            }
+            value->integer = (int32_t)integer_value;
+            return CL_ERR_NONE;
+        }
+        case DOUBLE:
+        case DOUBLE_LIST: {
+            if (string_value[0] == 0) {
+                return CL_ERR_MISSING_VALUE;
+            }
+            // Convert the actual number
+            double numeric_value;
+            CL_NumResult status = CL_strToDouble(string_value, &numeric_value);
+            if (status == CL_NUM_OVERFLOW) {
+                return CL_ERR_NUMBER_TOO_LARGE;
+            }
+            if (status != CL_NUM_OK) {
+                return CL_ERR_INVALID_NUMBER;
+            }
+            // Check if it is out of the range provided by the schema
+            if (option->doubleOptions.minValue != 0.0 || option->doubleOptions.maxValue != 0.0) {
+                if (numeric_value < option->doubleOptions.minValue || numeric_value > option->doubleOptions.maxValue) {
+                    return CL_ERR_OUT_OF_RANGE;
+                }
+            }
+            value->number = numeric_value;
+            return CL_ERR_NONE;
+        }
+        case END:
+        case HELP:
+        case BOOLEAN:
+        case SUBCOMMAND:
+            value->boolean = true;
+            return CL_ERR_NONE;
+    }
+    return CL_ERR_NONE;
+}
+
+// Whether the value of an option is left unconverted when parsing lazily (a missing value is
+// still reported while parsing). The value is only read for those option types
+static inline bool isLazy(const CL_Option* option, const char* string_value) {
+    return (option->type == INT || option->type == DOUBLE || (option->type == STRING && hasChoices(option))) && string_value[0] != '\0';
+}
+
+// Value of an option that is not passed
+static CL_FlagValue defaultValue(const CL_Option* option) {
+    switch (option->type) {
+        case HELP:
+        case BOOLEAN:
+        case SUBCOMMAND:
+            return (CL_FlagValue){.boolean = false};
+        case STRING:
+            if (hasChoices(option)) {
+                return (CL_FlagValue){.choice = {.string = (char*)option->strOptions.oneOf[0], .index = 0}};
+            }
+            return (CL_FlagValue){.string = option->strOptions.defaultValue};
+        case INT:
+            return (CL_FlagValue){.integer = option->intOptions.defaultValue};
+        case DOUBLE:
+            return (CL_FlagValue){.number = option->doubleOptions.defaultValue};
+        case STRING_LIST:
+        case INT_LIST:
+        case DOUBLE_LIST:  // Empty lists
+        case END:  // Unreachable
+            break;
+    }
+    return (CL_FlagValue){0};
+}
+
+// ITERATOR
+
+// Kinds of arguments, classified ahead of parsing
+enum {
+    // Value (including "-" and a lone "@")
+    ARG_VALUE,
+    // "-x"
+    ARG_SHORT,
+    // "-xyz"
+    ARG_GROUP,
+    // "--name"
+    ARG_LONG,
+    // "--name=value"
+    ARG_LONG_INLINE,
+    // "@file"
+    ARG_RESPONSE,
+};
+
+// Kind of an argument, storing the name length and hash of long flags
+static inline uint8_t classifyArg(const char* arg, uint32_t* nameLength, uint32_t* nameHash) {
+    if (arg[0] == '@') {
+        return arg[1] != '\0' ? ARG_RESPONSE : ARG_VALUE;
+    }
+    if (arg[0] != '-' || arg[1] == '\0') {
+        return ARG_VALUE;
+    }
+    if (arg[1] != '-') {
+        return arg[2] != '\0' ? ARG_GROUP : ARG_SHORT;
+    }
+    size_t length;
+    *nameHash = hashFlagName(arg + 2, &length);
+    *nameLength = (uint32_t)length;
+    return arg[2 + length] == '=' ? ARG_LONG_INLINE : ARG_LONG;
+}
+
+// Kinds of arguments from their first three characters (packed in lanes, and 0 past the end
+// of an argument), with long flags not yet told apart from inline ones
+static void classifyLanes(const uint8_t* c0, const uint8_t* c1, const uint8_t* c2, uint8_t* kinds, size_t count) {
+    size_t i = 0;
+#if defined(__SSE2__)
+    // 16 arguments at a time, combining the kinds selected by the comparison masks
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= count; i += 16) {
+        __m128i first = _mm_loadu_si128((const __m128i*)(c0 + i));
+        __m128i second = _mm_loadu_si128((const __m128i*)(c1 + i));
+        __m128i third = _mm_loadu_si128((const __m128i*)(c2 + i));
+        __m128i hasSecond = _mm_andnot_si128(_mm_cmpeq_epi8(second, zero), _mm_set1_epi8(-1));
+        __m128i hasThird = _mm_andnot_si128(_mm_cmpeq_epi8(third, zero), _mm_set1_epi8(1));
+        __m128i dash = _mm_cmpeq_epi8(first, _mm_set1_epi8('-'));
+        __m128i dashDash = _mm_and_si128(dash, _mm_cmpeq_epi8(second, _mm_set1_epi8('-')));
+        __m128i response = _mm_and_si128(_mm_cmpeq_epi8(first, _mm_set1_epi8('@')), hasSecond);
+        __m128i shortFlag = _mm_andnot_si128(dashDash, _mm_and_si128(dash, hasSecond));
+        __m128i kind = _mm_and_si128(response, _mm_set1_epi8(ARG_RESPONSE));
+        kind = _mm_or_si128(kind, _mm_and_si128(shortFlag, _mm_add_epi8(_mm_set1_epi8(ARG_SHORT), hasThird)));
+        kind = _mm_or_si128(kind, _mm_and_si128(dashDash, _mm_set1_epi8(ARG_LONG)));
+        _mm_storeu_si128((__m128i*)(kinds + i), kind);
+    }
+#endif
+    for (; i < count; i++) {
+        uint8_t kind = ARG_VALUE;
+        if (c0[i] == '@' && c1[i]) {
+            kind = ARG_RESPONSE;
+        } else if (c0[i] == '-' && c1[i] == '-') {
+            kind = ARG_LONG;
+        } else if (c0[i] == '-' && c1[i]) {
+            kind = c2[i] ? ARG_GROUP : ARG_SHORT;
+        }
+        kinds[i] = kind;
+    }
+}
+
+// Classify the next window of arguments of an iterator (up to the end of the window slots), in
+// one pass over them
+static void classifyWindow(CL_Iter* it) {
+    unsigned start = (unsigned)it->index & (CL_ITER_WINDOW - 1);
+    size_t count = CL_ITER_WINDOW - start;
+    if ((size_t)(it->argc - it->index) < count) {
+        count = it->argc - it->index;
+    }
+    // Pack the first characters of the arguments, reading each only up to its end
+    uint8_t c0[CL_ITER_WINDOW], c1[CL_ITER_WINDOW], c2[CL_ITER_WINDOW];
+    char** argv = it->argv + it->index;
+    for (size_t i = 0; i < count; i++) {
+        const char* arg = argv[i];
+        c0[i] = arg[0];
+        c1[i] = c0[i] ? arg[1] : 0;
+        c2[i] = c1[i] ? arg[2] : 0;
+    }
+    uint8_t* kinds = it->kinds + start;
+    classifyLanes(c0, c1, c2, kinds, count);
+    // With a schema, long flags also get their name length and hash, and whether they have an
+    // inline value (without one, names are not looked up)
+    for (size_t i = 0; it->compiled && i < count; i++) {
+        if (kinds[i] == ARG_LONG) {
+            size_t length;
+            const char* name = argv[i] + 2;
+            it->nameHashes[start + i] = hashFlagName(name, &length);
+            it->nameLengths[start + i] = (uint32_t)length;
+            kinds[i] = name[length] == '=' ? ARG_LONG_INLINE : ARG_LONG;
+        }
+    }
+    it->windowEnd = it->index + (int)count;
+}
+
+// Begin iterating, registering response file mappings in the given arena (or in an arena
+// owned by the iterator if NULL)
+static CL_Iter iterBegin(int argc, char* argv[], const CL_Compiled* compiled, CL_Arena* arena) {
+    return (CL_Iter){
+        .argc = argc,
+        .argv = argv,
+        .compiled = compiled,
+        .index = 1,
+        .arena = arena,
+        .ownsArena = false,
+    };
+}
+
+CL_Iter CL_iterBegin(int argc, char* argv[], const CL_Compiled* compiled) {
+    return iterBegin(argc, argv, compiled, NULL);
+}
+
+void CL_iterEnd(CL_Iter* it) {
+    if (it->ownsArena) {
+        arenaFree(it->arena);
+    }
+    it->arena = NULL;
+    it->ownsArena = false;
+}
+
+// Arena of an iterator, created on first use if it was not given one
+static CL_Arena* iterArena(CL_Iter* it) {
+    if (!it->arena) {
+        it->arena = arenaCreate(&defaultAllocator, 0);
+        it->ownsArena = true;
+    }
+    return it->arena;
+}
+
+// Read the next argument and its kind into the pending token, expanding response files on the
+// fly (NULL at the end)
+static char* fetchToken(CL_Iter* it) {
+    while (true) {
+        // Continue with the response file being read (whose tokens are classified one by one,
+        // and can't be response files themselves)
+        if (it->fileCursor) {
+            char* token = nextResponseToken(&it->fileCursor, it->fileEnd);
+            if (token) {
+                it->pendingIndex = it->index - 1;
+                it->pendingKind = classifyArg(token, &it->pendingLength, &it->pendingHash);
+                if (it->pendingKind == ARG_RESPONSE) {
+                    it->pendingKind = ARG_VALUE;
+                }
+                return token;
+            }
+            it->fileCursor = NULL;
+        }
+        if (it->index >= it->argc) {
+            return NULL;
+        }
+        if (it->index >= it->windowEnd) {
+            classifyWindow(it);
+        }
+        unsigned slot = (unsigned)it->index & (CL_ITER_WINDOW - 1);
+        char* arg = it->argv[it->index++];
+        it->pendingKind = it->kinds[slot];
+        if (it->pendingKind == ARG_LONG || it->pendingKind == ARG_LONG_INLINE) {
+            it->pendingLength = it->nameLengths[slot];
+            it->pendingHash = it->nameHashes[slot];
+        }
+        if (it->pendingKind == ARG_RESPONSE) {
+            size_t size;
+            char* data = mapResponseFile(iterArena(it), arg + 1, &size);
+            if (data) {
+                it->fileCursor = data;
+                it->fileEnd = data + size;
+                continue;
+            }
+            it->pendingKind = ARG_VALUE;
+        }
+        it->pendingIndex = it->index - 1;
+        return arg;
+    }
+}
+
+// Look at the next argument without consuming it
+static char* peekToken(CL_Iter* it) {
+    if (!it->pending) {
+        it->pending = fetchToken(it);
+    }
+    return it->pending;
+}
+
+// Consume the next argument (its kind becomes the current one)
+static char* takeToken(CL_Iter* it) {
+    char* token = peekToken(it);
+    it->pending = NULL;
+    it->argIndex = it->pendingIndex;
+    it->kind = it->pendingKind;
+    it->nameLength = it->pendingLength;
+    it->nameHash = it->pendingHash;
+    return token;
+}
+
+// Consume the next argument as the value of a flag, if it is not a long flag itself ("" otherwise)
+static char* takeFlagValue(CL_Iter* it) {
+    char* next = peekToken(it);
+    if (next && it->pendingKind != ARG_LONG && it->pendingKind != ARG_LONG_INLINE) {
+        return takeToken(it);
+    }
+    return "";
+}
+
+// Take the run of plain values (at most max) starting at the next argument, without going
+// through events, returning how many were stored in values. Only arguments classified ahead are
+// taken, so there are none while a response file, group or read ahead token is pending
+static size_t takeValues(CL_Iter* it, char** values, size_t max) {
+    if (it->pending || it->fileCursor || it->group) {
+        return 0;
+    }
+    size_t count = 0;
+    while (count < max && it->index < it->argc) {
+        if (it->index >= it->windowEnd) {
+            classifyWindow(it);
+        }
+        if (it->kinds[(unsigned)it->index & (CL_ITER_WINDOW - 1)] != ARG_VALUE) {
+            break;
+        }
+        it->argIndex = it->index;
+        values[count++] = it->argv[it->index++];
+    }
+    return count;
+}
+
+// Fill in an error event
+static bool iterError(CL_Event* event, const char* flag, CL_FlagId id, CL_ErrorCode code, int offset) {
+    event->type = CL_EVENT_ERROR;
+    event->id = id;
+    event->flag = flag;
+    event->code = code;
+    event->message = errorMessages[code];
+    event->offset = offset;
+    return true;
+}
+
+bool CL_next(CL_Iter* it, CL_Event* event) {
+    const CL_Compiled* compiled = it->compiled;
+    *event = (CL_Event){.id = CL_NO_FLAG, .suggestion = CL_NO_FLAG};
+
+    // Continue with the remaining characters of grouped short flags
+    while (it->group && *it->group) {
+        unsigned char abbr = *it->group++;
+        event->argIndex = it->argIndex;
+        // Abbreviations of boolean options (the usual case) are found in the bitmap alone
+        if (compiled->boolean_abbrs[abbr >> 6] & (1ull << (abbr & 63))) {
+            event->type = CL_EVENT_FLAG;
+            event->id = compiled->abbr_index[abbr];
+            event->flag = compiled->schema[event->id].name;
+            event->value.boolean = true;
+            return true;
+        }
+        size_t i = findShortOption(compiled, abbr);
+        if (i == SIZE_MAX) {
+            continue;
+        }
+        // Grouped flags must be boolean (which will then be set to true)
+        if (compiled->hot[i].type != BOOLEAN) {
+            it->shortFlag[0] = abbr;
+            it->shortFlag[1] = '\0';
+            return iterError(event, it->shortFlag, i, CL_ERR_GROUPED_NOT_BOOLEAN, (int)(it->group - 1 - it->groupArg));
+        }
+        event->type = CL_EVENT_FLAG;
+        event->id = i;
+        event->flag = compiled->schema[i].name;
+        event->value.boolean = true;
+        return true;
+    }
+    it->group = NULL;
+
+    char* arg = takeToken(it);
+    if (!arg) {
+        return false;
+    }
+    event->argIndex = it->argIndex;
+
+    if (it->kind == ARG_VALUE || (!compiled && (it->kind == ARG_SHORT || it->kind == ARG_GROUP))) {
+        // Not a flag, just a value
+        event->type = CL_EVENT_VALUE;
+        event->value.string = arg;
+        return true;
+    }
+
+    if (!compiled) {
+        // No schema defined; the flag takes its inline value or the next argument as a string value,
+        // if it is not a flag
+        event->type = CL_EVENT_FLAG;
+        char* equals = strchr(arg + 2, '=');
+        if (equals) {
+            // The name is copied, so that the argument isn't modified
+            size_t len = equals - (arg + 2);
+            char* name = arenaAlloc(iterArena(it), len + 1);
+            memcpy(name, arg + 2, len);
+            event->flag = name;
+            event->value.string = equals + 1;
+            return true;
+        }
+        event->flag = arg + 2;
+        event->value.string = takeFlagValue(it);
+        return true;
+    }
+
+    // Schema defined, find option in schema
+    size_t flag_index;
+    char* inline_value = NULL;
+    if (it->kind == ARG_GROUP) {
+        // Process the short flags one by one
+        it->group = arg + 1;
+        it->groupArg = arg;
+        return CL_next(it, event);
+    }
+    if (it->kind == ARG_SHORT) {
+        flag_index = findShortOption(compiled, arg[1]);
+    } else {
+        // Long flag: the exact name or else a unique prefix of one, up to an inline "=value"
+        size_t len = it->nameLength;
+        uint32_t hash = it->nameHash;
+        if (it->kind == ARG_LONG_INLINE) {
+            inline_value = arg + 3 + len;
+        }
+        flag_index = findHashedOption(compiled, arg + 2, len, hash);
+        if (flag_index == SIZE_MAX) {
+            bool ambiguous;
+            flag_index = findPrefixOption(compiled, arg + 2, len, &ambiguous);
+            if (ambiguous) {
+                return iterError(event, arg, CL_NO_FLAG, CL_ERR_AMBIGUOUS_OPTION, 0);
+            }
+        }
+        if (flag_index == SIZE_MAX) {
+            event->suggestion = suggestOption(compiled, arg + 2, len);
+        }
+    }
+    // Check if the flag has been found (subcommands are selected by value, not by flag)
+    if (flag_index == SIZE_MAX || compiled->hot[flag_index].type == SUBCOMMAND) {
+        return iterError(event, arg, CL_NO_FLAG, CL_ERR_UNKNOWN_OPTION, 0);
+    }
+
+    const CL_Option* option = &compiled->schema[flag_index];
+    event->type = CL_EVENT_FLAG;
+    event->id = flag_index;
+    event->flag = option->name;
+    switch (option->type) {
+        case STRING:
+        case INT:
+        case DOUBLE:
+        case STRING_LIST:
+        case INT_LIST:
+        case DOUBLE_LIST: {
+            // Use the inline value, or if the next arg is not a flag, treat it as the value (kept as
+            // a string when parsing lazily)
+            char* string_value = inline_value ? inline_value : takeFlagValue(it);
+            if (it->lazy && isLazy(option, string_value)) {
+                event->value.string = string_value;
+                break;
+            }
+            CL_ErrorCode error = convertValue(compiled, flag_index, string_value, &event->value);
+            if (error) {
+                return iterError(event, option->name, flag_index, error, inline_value ? (int)(inline_value - arg) : 0);
+            }
+            break;
+        }
+        case END:  // Unreachable
+        case SUBCOMMAND:
+        case HELP:
+        case BOOLEAN:
+            if (inline_value) {
+                return iterError(event, option->name, flag_index, CL_ERR_UNEXPECTED_VALUE, (int)(inline_value - arg));
+            }
+            event->value.boolean = true;
+            break;
+    }
+    return true;
+}
+
+// PARSER
+
+// Context handlers of the legacy API, forwarding to the global callbacks
+static void legacyErrorHandler(const char* flag, const char* msg, void* userData) {
+    (void)userData;
+    parseErrorCallback(flag, (char*)msg);
+}
+static bool legacyHelpHandler(const CL_Schema schema, const char* progname, void* userData) {
+    (void)userData;
+    if (helpCallback(schema, progname)) {
+        exit(0);
+    }
+    return false;
+}
+
+// Context used by the functions that don't take one
+static CL_Context legacyContext(const CL_Allocator* allocator) {
+    return (CL_Context){
+        .onError = legacyErrorHandler,
+        .onHelp = legacyHelpHandler,
+        .userData = NULL,
+        .allocator = allocator,
+    };
+}
+
+// Make room for one more item in an array that only grows, doubling its capacity (implicitly
+// the next power of 2 from 4) when the count reaches it
+static void* growArray(CL_Arena* arena, void* array, uint32_t count, size_t item_size) {
+    if (count == 0 || (count >= 4 && (count & (count - 1)) == 0)) {
+        size_t cap = count == 0 ? 4 : (size_t)count * 2;
+        return arenaGrow(arena, array, count * item_size, cap * item_size);
+    }
+    return array;
+}
+
+// Append an item to the packed array of a list option
+static void appendListItem(CL_Arena* arena, CL_OptionType type, CL_FlagValue* list, CL_FlagValue item) {
+    size_t item_size = type == STRING_LIST ? sizeof(char*) : type == INT_LIST ? sizeof(int32_t) : sizeof(double);
+    uint32_t count = list->list.count;
+    list->list.strings = growArray(arena, list->list.strings, count, item_size);
+    switch (type) {
+        case STRING_LIST:
+            list->list.strings[count] = item.string;
+            break;
+        case INT_LIST:
+            list->list.integers[count] = item.integer;
+            break;
+        default:
+            list->list.numbers[count] = item.number;
+            break;
+    }
+    list->list.count = count + 1;
+}
+
+// Count a parse error (of the given flag), keeping the first one (and all of them if the context
+// collects errors) and passing it to the error handler
+static void parseError(const CL_Context* ctx, CL_Arena* arena, CL_Args* args, CL_Error* firstError, const char* flag, CL_Error error) {
+    error.message = errorMessages[error.code];
+    if (firstError && args->error_count == 0) {
+        *firstError = error;
+    }
+    if (ctx->collectErrors) {
+        args->errors = growArray(arena, args->errors, args->error_count, sizeof(CL_Error));
+        args->errors[args->error_count] = error;
+    }
+    args->error_count++;
+    if (!ctx->onError) {
+        return;
+    }
+    // Only the handler gets the suggestion in the message (formatted on the stack)
+    if (error.suggestion != CL_NO_FLAG) {
+        char message[128 + MAX_SUGGESTION_LENGTH];
+        snprintf(message, sizeof(message), "%s, did you mean --%s?", error.message, args->schema[error.suggestion].name);
+        ctx->onError(flag, message, ctx->userData);
+        return;
+    }
+    // And the other option of a violated constraint
+    if (error.related != CL_NO_FLAG) {
+        char message[128 + MAX_SUGGESTION_LENGTH];
+        snprintf(message, sizeof(message), "%s --%s", error.message, args->schema[error.related].name);
+        ctx->onError(flag, message, ctx->userData);
+        return;
+    }
+    ctx->onError(flag, error.message, ctx->userData);
+}
+
+// Set an option from the environment or the config file (named source). Booleans accept
+// 1/0, true/false, yes/no and on/off, and list options get the value as their only item
+static void setLayerValue(const CL_Context* ctx, CL_Arena* arena, const CL_Compiled* compiled, CL_Args* args, bool* layered, size_t i, char* string, const char* source, CL_Error* firstError) {
+    const CL_Option* option = &args->schema[i];
+    CL_FlagValue value;
+    CL_ErrorCode error = CL_ERR_NONE;
+    switch (option->type) {
+        case HELP:
+        case SUBCOMMAND:
+        case END:  // Unreachable
+            return;
+        case BOOLEAN:
+            if (!strcmp(string, "1") || !strcmp(string, "true") || !strcmp(string, "yes") || !strcmp(string, "on")) {
+                value.boolean = true;
+            } else if (!strcmp(string, "0") || !strcmp(string, "false") || !strcmp(string, "no") || !strcmp(string, "off") || !*string) {
+                value.boolean = false;
+            } else {
+                error = CL_ERR_INVALID_BOOLEAN;
+            }
+            break;
+        default:
+            // Kept as a string when parsing lazily
+            if (args->unconverted && isLazy(option, string)) {
+                args->options[i].value.string = string;
+                args->unconverted[i >> 6] |= 1ull << (i & 63);
+                args->set[i >> 6] |= 1ull << (i & 63);
+                return;
+            }
+            error = convertValue(compiled, i, string, &value);
+            break;
+    }
+    if (error) {
+        parseError(ctx, arena, args, firstError, source, (CL_Error){.argIndex = -1, .id = i, .code = error, .suggestion = CL_NO_FLAG, .related = CL_NO_FLAG});
+        return;
+    }
+    if (isListType(option->type)) {
+        args->options[i].value.list.count = 0;
+        appendListItem(arena, option->type, &args->options[i].value, value);
+        layered[i] = true;
+    } else {
+        args->options[i].value = value;
+    }
+    args->set[i >> 6] |= 1ull << (i & 63);
+}
+
+// Set the options named in the config file, then in the environment (which takes precedence)
+static void applyLayers(const CL_Context* ctx, CL_Arena* arena, const CL_Compiled* compiled, CL_Args* args, bool* layered, const CL_Layers* layers, CL_Error* firstError) {
+    for (size_t e = 0; e < layers->entry_count; e++) {
+        const CL_ConfigEntry* entry = &layers->entries[e];
+        size_t i = findLayerName(compiled, compiled->key_table, false, entry->key, strlen(entry->key));
+        if (i != SIZE_MAX) {
+            setLayerValue(ctx, arena, compiled, args, layered, i, entry->value, entry->key, firstError);
+        }
+    }
+    for (char** variable = layers->environ; variable && *variable; variable++) {
+        char* equals = strchr(*variable, '=');
+        if (!equals) {
+            continue;
+        }
+        size_t i = findLayerName(compiled, compiled->env_table, true, *variable, equals - *variable);
+        if (i != SIZE_MAX) {
+            setLayerValue(ctx, arena, compiled, args, layered, i, equals + 1, compiled->schema[i].env, firstError);
+        }
+    }
+}
+
+// Report a violated constraint about an option (and the option it requires or conflicts with)
+static void constraintError(const CL_Context* ctx, CL_Arena* arena, CL_Args* args, CL_Error* firstError, CL_ErrorCode code, CL_FlagId id, CL_FlagId related) {
+    parseError(ctx, arena, args, firstError, args->schema[id].name, (CL_Error){.argIndex = -1, .id = id, .code = code, .suggestion = CL_NO_FLAG, .related = related});
+}
+
+// Check the constraints of the schema against the options set explicitly, with the bits of the
+// choice terms set first, so that each constraint is a few word-wide operations on its mask
+static void checkConstraints(const CL_Context* ctx, CL_Arena* arena, const CL_Compiled* compiled, CL_Args* args, CL_Error* firstError) {
+    uint64_t* set = args->set;
+    for (uint32_t t = 0; t < compiled->choice_term_count; t++) {
+        const CL_ChoiceTerm* term = &compiled->choice_terms[t];
+        CL_FlagValue value;
+        if ((set[term->option >> 6] >> (term->option & 63) & 1) && CL_flagChecked(args, term->option, &value) == CL_ERR_NONE && value.choice.index == term->choice) {
+            uint32_t bit = compiled->option_count + t;
+            set[bit >> 6] |= 1ull << (bit & 63);
+        }
+    }
+    for (uint32_t c = 0; c < compiled->constraint_count; c++) {
+        const CL_CompiledConstraint* constraint = &compiled->constraints[c];
+        bool bySubject = constraint->kind == CL_CONSTRAINT_REQUIRES || constraint->kind == CL_CONSTRAINT_CONFLICTS;
+        if (bySubject && !(set[constraint->subject >> 6] >> (constraint->subject & 63) & 1)) {
+            continue;
+        }
+        CL_FlagId subject = termOption(compiled, constraint->subject);
+        // First term of the group that is set (every other one conflicts with it for EXACTLY_ONE)
+        CL_FlagId first = CL_NO_FLAG;
+        for (uint32_t w = 0; w < compiled->term_words; w++) {
+            // Terms missing for REQUIRES, set otherwise
+            uint64_t terms = constraint->mask[w] & (constraint->kind == CL_CONSTRAINT_REQUIRES ? ~set[w] : set[w]);
+            for (; terms; terms &= terms - 1) {
+                CL_FlagId option = termOption(compiled, w * 64 + __builtin_ctzll(terms));
+                if (constraint->kind == CL_CONSTRAINT_REQUIRES) {
+                    constraintError(ctx, arena, args, firstError, CL_ERR_MISSING_REQUIRED, subject, option);
+                } else if (constraint->kind == CL_CONSTRAINT_CONFLICTS) {
+                    constraintError(ctx, arena, args, firstError, CL_ERR_CONFLICTING_OPTION, subject, option);
+                } else if (first == CL_NO_FLAG) {
+                    first = option;
+                } else if (constraint->kind == CL_CONSTRAINT_EXACTLY_ONE) {
+                    constraintError(ctx, arena, args, firstError, CL_ERR_CONFLICTING_OPTION, option, first);
+                } else {
+                    break;
+                }
+            }
+        }
+        if (!bySubject && first == CL_NO_FLAG) {
+            // The handler gets the options of the group as the flag (listed on the stack, as far as they fit)
+            char names[MAX_GROUP_NAMES_LENGTH] = "";
+            size_t length = 0;
+            for (const char* const* name = constraint->source->options; ctx->onError && *name; name++) {
+                int written = snprintf(names + length, sizeof(names) - length, length ? ", %s" : "%s", *name);
+                if (written < 0 || (size_t)written >= sizeof(names) - length) {
+                    break;
+                }
+                length += written;
+            }
+            parseError(ctx, arena, args, firstError, names,
+                       (CL_Error){.argIndex = -1, .id = subject, .code = CL_ERR_MISSING_ONE_OF, .suggestion = CL_NO_FLAG, .related = CL_NO_FLAG});
+        }
+    }
+}
+
+// Memory needed by the arrays of a parse result (including the bitsets of the options set and,
+// when parsing lazily, of unconverted values)
+static size_t parseSize(const CL_Context* ctx, int argc, const CL_Compiled* compiled) {
+    size_t value_cap = argc > 1 ? argc - 1 : 0;
+    size_t option_cap = compiled ? compiled->option_count : value_cap;
+    size_t size = alignUp(option_cap * sizeof(CL_FlagOption)) + alignUp(value_cap * sizeof(char*));
+    if (compiled) {
+        size += alignUp(compiled->term_words * sizeof(uint64_t));
+    }
+    if (ctx->lazy && compiled) {
+        size += alignUp((option_cap + 63) / 64 * sizeof(uint64_t));
+    }
+    return size;
+}
+
+// Parse the remaining arguments of an iterator against its compiled schema (or without a schema),
+// on top of the given layers (if not NULL), allocating the results in the given arena with room
+// for value_cap values (growing if needed). The first error is stored in firstError, if not NULL
+static CL_Args parseFrom(const CL_Context* ctx, CL_Arena* arena, CL_Iter* it, char* path, size_t value_cap, const CL_Layers* layers, CL_Error* firstError) {
+    const CL_Compiled* compiled = it->compiled;
+    bool schemaDefined = compiled != NULL;
+    const CL_Option* schema = schemaDefined ? compiled->schema : NULL;
+    size_t option_cap = schemaDefined ? compiled->option_count : value_cap;
+
+    // Define args object to return
+    CL_Args args = {
+        .path = path,
+        .option_count = 0,
+        .value_count = 0,
+        .options = arenaAlloc(arena, option_cap * sizeof(CL_FlagOption)),
+        .values = arenaAlloc(arena, value_cap * sizeof(char*)),
+        .schema = schema,
+        .arena = arena,
+    };
+
+    // Add the schema options as unset in the args
+    if (schemaDefined) {
+        while (args.option_count < option_cap) {
+            args.options[args.option_count] = (CL_FlagOption){
+                .flag = schema[args.option_count].name,
+                .value = defaultValue(&schema[args.option_count]),
+            };
+            args.option_count++;
+        }
+    }
+    // Options set explicitly (with room for the choice terms of the constraints)
+    if (schemaDefined) {
+        args.set = arenaAlloc(arena, compiled->term_words * sizeof(uint64_t));
+    }
+    // Values parsed lazily are converted by CL_flagChecked, with the compiled schema
+    it->lazy = ctx->lazy && schemaDefined;
+    if (it->lazy) {
+        args.unconverted = arenaAlloc(arena, (option_cap + 63) / 64 * sizeof(uint64_t));
+        args.compiled = compiled;
+    }
+
+    // Options set by the environment or config file (lists set by them are replaced by argv, not appended to)
+    bool* layered = NULL;
+    if (layers && schemaDefined && compiled->has_layers) {
+        layered = arenaAlloc(arena, option_cap * sizeof(bool));
+        applyLayers(ctx, arena, compiled, &args, layered, layers, firstError);
+    }
+
+    // Process user arguments
+    CL_Event event;
+    while (CL_next(it, &event)) {
+        switch (event.type) {
+            case CL_EVENT_ERROR:
+                parseError(ctx, arena, &args, firstError, event.flag,
+                           (CL_Error){
+                               .argIndex = event.argIndex,
+                               .offset = event.offset,
+                               .id = event.id,
+                               .code = event.code,
+                               .suggestion = event.suggestion,
+                               .related = CL_NO_FLAG,
+                           });
+                break;
+            case CL_EVENT_FLAG:
+                if (schemaDefined) {
+                    args.set[event.id >> 6] |= 1ull << (event.id & 63);
+                    if (schema[event.id].type == HELP) {
+                        args.options[event.id].value.boolean = true;
+                        // Stop parsing after the help menu unless the handler says otherwise
+                        if (!ctx->onHelp || ctx->onHelp(schema, args.path, ctx->userData)) {
+                            args.help_requested = true;
+                            goto done;
+                        }
+                        break;
                     }
-                } else {
-                    argSpacingLength += 8;  // (value)
+                    if (isListType(schema[event.id].type)) {
+                        if (layered && layered[event.id]) {
+                            args.options[event.id].value.list.count = 0;
+                            layered[event.id] = false;
+                        }
+                        appendListItem(arena, schema[event.id].type, &args.options[event.id].value, event.value);
+                        break;
+                    }
+                    args.options[event.id].value = event.value;
+                    if (it->lazy && isLazy(&schema[event.id], event.value.string)) {
+                        args.unconverted[event.id >> 6] |= 1ull << (event.id & 63);
+                    }
+                    break;
                 }
-            case INT:
-                if (schema[i].intOptions.minValue == 0 && schema[i].intOptions.maxValue == 0) {
-                    argSpacingLength += 6;  // (int)
-                } else {
-                    argSpacingLength += snprintf(NULL, 0, " (%d..%d)", schema[i].intOptions.minValue, schema[i].intOptions.maxValue);
+                // No schema defined; add the option object with a string value (growing the array if
+                // response files added arguments)
+                if (args.option_count == option_cap) {
+                    args.options = arenaGrow(arena, args.options, option_cap * sizeof(CL_FlagOption), option_cap * 2 * sizeof(CL_FlagOption));
+                    option_cap *= 2;
                 }
+                args.options[args.option_count++] = (CL_FlagOption){
+                    .flag = event.flag,
+                    .value = event.value,
+                };
                 break;
-            case DOUBLE:
-                if (schema[i].doubleOptions.minValue == 0.0 && schema[i].doubleOptions.maxValue == 0.0) {
-                    argSpacingLength += 6;  // (num)
-                } else {
-                    argSpacingLength += snprintf(NULL, 0, " (%.2f..%.2f)", schema[i].doubleOptions.minValue, schema[i].doubleOptions.maxValue);
+            case CL_EVENT_VALUE:
+                // The first value may select a subcommand, which parses all the remaining arguments
+                if (schemaDefined && compiled->has_subcommands && args.value_count == 0) {
+                    size_t i = findLongOption(compiled, event.value.string);
+                    if (i != SIZE_MAX && schema[i].type == SUBCOMMAND) {
+                        args.options[i].value.boolean = true;
+                        args.set[i >> 6] |= 1ull << (i & 63);
+                        // Its help and errors show the subcommand as part of the program name
+                        size_t path_length = strlen(args.path);
+                        size_t name_length = strlen(schema[i].name);
+                        char* sub_path = arenaAlloc(arena, path_length + name_length + 2);
+                        memcpy(sub_path, args.path, path_length);
+                        sub_path[path_length] = ' ';
+                        memcpy(sub_path + path_length + 1, schema[i].name, name_length + 1);
+
+                        it->compiled = subcommandCompiled(compiled, i);
+                        CL_Args* sub = arenaAlloc(arena, sizeof(CL_Args));
+                        *sub = parseFrom(ctx, arena, it, sub_path, (size_t)(it->argc - it->index) + 1, layers, args.error_count == 0 ? firstError : NULL);
+                        sub->arena = NULL;  // Freed with these args
+                        args.subcommand = sub;
+                        // Its errors follow those of these args (in the same array when collected)
+                        if (ctx->collectErrors) {
+                            for (uint32_t e = 0; e < sub->error_count; e++) {
+                                args.errors = growArray(arena, args.errors, args.error_count, sizeof(CL_Error));
+                                args.errors[args.error_count++] = sub->errors[e];
+                            }
+                        } else {
+                            args.error_count += sub->error_count;
+                        }
+                        args.help_requested = sub->help_requested;
+                        goto done;
+                    }
                 }
-                break;
-            case END:
-            case HELP:
-            case BOOLEAN:
+                // Not a flag, just a value, copy to the values (growing the array if response files added arguments)
+                if (args.value_count == value_cap) {
+                    args.values = arenaGrow(arena, args.values, value_cap * sizeof(char*), value_cap * 2 * sizeof(char*));
+                    value_cap *= 2;
+                }
+                args.values[args.value_count++] = event.value.string;
+                // Copy the run of values following it directly
+                args.value_count += takeValues(it, args.values + args.value_count, value_cap - args.value_count);
                 break;
         }
-        if (argSpacingLength > maxSpacingLength) {
-            maxSpacingLength = argSpacingLength;
-        }
     }
 
-    if (progname) {
-        printf("Usage: %s [values] [options]\n\n", progname);
+done:
+    if (schemaDefined && compiled->constraint_count && !args.help_requested) {
+        checkConstraints(ctx, arena, compiled, &args, firstError);
     }
+    return args;
+}
 
-    printf("Options:\n");
-    for (size_t i = 0; schema[i].type != END; i++) {
-        if (schema[i].abbr) {
-            printf(" -%c, ", schema[i].abbr);
+// Parse the arguments against a compiled schema (or without a schema if compiled is NULL),
+// allocating the results in the given arena. The first error is stored in firstError, if not NULL
+static CL_Args parseInto(const CL_Context* ctx, CL_Arena* arena, int argc, char* argv[], const CL_Compiled* compiled, CL_Error* firstError) {
+    // Every argument after the program name is at most one value or one option, so unless
+    // response files add more arguments, the arrays can be allocated upfront (see parseSize)
+    CL_Iter it = iterBegin(argc, argv, compiled, arena);
+    return parseFrom(ctx, arena, &it, argc > 0 ? argv[0] : "", argc > 1 ? argc - 1 : 0, NULL, firstError);
+}
+
+// Parse the arguments into a new arena holding the results
+static CL_Args parseArgs(const CL_Context* ctx, int argc, char* argv[], const CL_Compiled* compiled) {
+    const CL_Allocator* allocator = ctx->allocator ? ctx->allocator : &defaultAllocator;
+    CL_Arena* arena = arenaCreate(allocator, parseSize(ctx, argc, compiled));
+    return parseInto(ctx, arena, argc, argv, compiled, NULL);
+}
+
+CL_Args CL_parseContext(const CL_Context* ctx, int argc, char* argv[], const CL_Compiled* compiled) {
+    return parseArgs(ctx, argc, argv, compiled);
+}
+
+CL_Args CL_parseLayered(const CL_Context* ctx, int argc, char* argv[], const CL_Compiled* compiled, const char* configPath) {
+    const CL_Allocator* allocator = ctx->allocator ? ctx->allocator : &defaultAllocator;
+    CL_Arena* arena = arenaCreate(allocator, parseSize(ctx, argc, compiled));
+    CL_Layers layers = {
+        .environ = environ,
+    };
+    // The config file stays mapped (its values point into it) until the args are freed
+    bool configRead = true;
+    if (configPath) {
+        size_t size;
+        char* data = mapResponseFile(arena, configPath, &size);
+        if (data) {
+            readConfigEntries(arena, data, size, &layers);
         } else {
-            printf("     ");
+            configRead = false;
         }
-        // Print flag name
-        int spaceNeeded = printf("--%s", schema[i].name) - 2;  // Keep track of space needed to reach max width
-        // Print hint for flag value, if necessary
+    }
+    CL_Iter it = iterBegin(argc, argv, compiled, arena);
+    CL_Args args = parseFrom(ctx, arena, &it, argc > 0 ? argv[0] : "", argc > 1 ? argc - 1 : 0, &layers, NULL);
+    if (!configRead) {
+        parseError(ctx, arena, &args, NULL, configPath, (CL_Error){.argIndex = -1, .id = CL_NO_FLAG, .code = CL_ERR_CONFIG_UNREADABLE, .suggestion = CL_NO_FLAG, .related = CL_NO_FLAG});
+    }
+    return args;
+}
+
+CL_Args CL_parseCompiled(int argc, char* argv[], const CL_Compiled* compiled) {
+    CL_Context ctx = legacyContext(NULL);
+    return parseArgs(&ctx, argc, argv, compiled);
+}
+
+CL_Args CL_parseWithAllocator(int argc, char* argv[], const CL_Schema schema, const CL_Allocator* allocator) {
+    CL_Context ctx = legacyContext(allocator);
+    if (!schema) {
+        return parseArgs(&ctx, argc, argv, NULL);
+    }
+    // The temporary compiled schema (and those of the subcommands selected) use the allocator too
+    CL_Compiled* compiled = compileSchema(schema, allocator ? allocator : &defaultAllocator);
+    CL_Args args = parseArgs(&ctx, argc, argv, compiled);
+    CL_freeCompiled(compiled);
+    return args;
+}
+
+CL_Args CL_parse(int argc, char* argv[], const CL_Schema schema) {
+    return CL_parseWithAllocator(argc, argv, schema, &defaultAllocator);
+}
+
+// SERIALIZATION
+
+// Magic number and version of serialized images ("CLA" and version 5)
+#define IMAGE_MAGIC 0x05414C43u
+
+// What the value of an option points to (the kind bytes of an image)
+enum {
+    KIND_NONE,
+    KIND_STRING,
+    KIND_STRING_LIST,
+    KIND_INT_LIST,
+    KIND_DOUBLE_LIST,
+};
+
+// Header of a serialized image. It is followed by the options and values arrays (with pointers
+// stored as offsets from the start of the image, 0 for NULL), the bitset of the options set
+// (option_count / 64 + 1 words), one kind byte per option, the
+// arrays of list options and the strings. Images are never written to once serialized
+typedef struct {
+    uint32_t magic;
+    uint32_t option_count;
+    uint64_t schemaHash;
+    uint64_t size;
+    // Number of items of the string lists (whose pointers go in the table of CL_deserialize)
+    uint64_t string_items;
+    uint64_t path;
+    uint32_t value_count;
+    uint32_t error_count;
+    uint8_t help_requested;
+    uint8_t padding[7];
+} CL_ImageHeader;
+
+// Hash of everything in a schema that affects parse results (0 without a schema)
+static uint64_t schemaHash(const CL_Option* schema) {
+    if (!schema) {
+        return 0;
+    }
+    uint64_t hash = 14695981039346656037ull;
+#define HASH_BYTES(ptr, len)                                   \
+    for (size_t b = 0; b < (len); b++) {                       \
+        hash = (hash ^ ((const unsigned char*)(ptr))[b]) * 1099511628211ull; \
+    }
+    for (size_t i = 0; schema[i].type != END; i++) {
+        HASH_BYTES(schema[i].name, strlen(schema[i].name) + 1);
+        HASH_BYTES(&schema[i].abbr, 1);
+        HASH_BYTES(&schema[i].type, sizeof(schema[i].type));
         switch (schema[i].type) {
-            case STRING:
-                if (schema[i].strOptions.oneOf[0]) {
-                    spaceNeeded += printf(" (");
-                    size_t o = 0;
-                    while (schema[i].strOptions.oneOf[o + 1]) {
-                        spaceNeeded += printf("%s/", schema[i].strOptions.oneOf[o++]);
-                    }
-                    spaceNeeded += printf("%s)", schema[i].strOptions.oneOf[o]);
-                } else if (schema[i].strOptions.optional) {
-                    spaceNeeded += printf(" [value]");
-                } else {
-                    spaceNeeded += printf(" (value)");
-                };
-                break;
             case INT:
-                if (schema[i].intOptions.minValue == 0 && schema[i].intOptions.maxValue == 0) {
-                    spaceNeeded += printf(" (int)");
-                } else {
-                    spaceNeeded += printf(" (%d..%d)", schema[i].intOptions.minValue, schema[i].intOptions.maxValue);
-                }
+            case INT_LIST:
+                HASH_BYTES(&schema[i].intOptions, sizeof(schema[i].intOptions));
                 break;
             case DOUBLE:
-                if (schema[i].doubleOptions.minValue == 0.0 && schema[i].doubleOptions.maxValue == 0.0) {
-                    spaceNeeded += printf(" (num)");
-                } else {
-                    spaceNeeded += printf(" (%.2f..%.2f)", schema[i].doubleOptions.minValue, schema[i].doubleOptions.maxValue);
+            case DOUBLE_LIST:
+                HASH_BYTES(&schema[i].doubleOptions, sizeof(schema[i].doubleOptions));
+                break;
+            case STRING:
+                HASH_BYTES(&schema[i].strOptions.optional, 1);
+                HASH_BYTES(&schema[i].strOptions.match, 1);
+                for (int o = 0; hasChoices(&schema[i]) && schema[i].strOptions.oneOf[o]; o++) {
+                    HASH_BYTES(schema[i].strOptions.oneOf[o], strlen(schema[i].strOptions.oneOf[o]) + 1);
                 }
+                break;
+            case SUBCOMMAND: {
+                uint64_t subcommand_hash = schemaHash(schema[i].subcommand.schema);
+                HASH_BYTES(&subcommand_hash, sizeof(subcommand_hash));
+                break;
+            }
             case END:
             case HELP:
             case BOOLEAN:
+            case STRING_LIST:
                 break;
         }
-        // Pad with space left and print description
-        printf("%*s%s\n", maxSpacingLength - spaceNeeded, "", schema[i].description);
     }
+#undef HASH_BYTES
+    return hash;
+}
 
-    return true;
+// Kind of the value of an option (every option holds a string without a schema)
+static inline uint8_t valueKind(const CL_Option* schema, uint32_t i) {
+    if (!schema) {
+        return KIND_STRING;
+    }
+    switch (schema[i].type) {
+        case STRING:
+            return KIND_STRING;
+        case STRING_LIST:
+            return KIND_STRING_LIST;
+        case INT_LIST:
+            return KIND_INT_LIST;
+        case DOUBLE_LIST:
+            return KIND_DOUBLE_LIST;
+        default:
+            return KIND_NONE;
+    }
 }
 
-CL_ParseErrorCallback parseErrorCallback = defaultParseErrorCallback;
-CL_HelpCallback helpCallback = defaultHelpCallback;
+// Size of an item of a list kind
+static inline size_t kindItemSize(uint8_t kind) {
+    return kind == KIND_STRING_LIST ? sizeof(char*) : kind == KIND_INT_LIST ? sizeof(int32_t) : sizeof(double);
+}
 
-void CL_setParseErrorCallback(CL_ParseErrorCallback cb) {
-    parseErrorCallback = cb;
+// Copy a string into the image (if it fits), returning its offset (0 for NULL)
+static uint64_t imageString(char* image, size_t cap, size_t* used, const char* string) {
+    if (!string) {
+        return 0;
+    }
+    size_t length = strlen(string) + 1;
+    uint64_t offset = *used;
+    if (image && *used + length <= cap) {
+        memcpy(image + *used, string, length);
+    }
+    *used += length;
+    return offset;
 }
-void CL_setHelpCallback(CL_HelpCallback cb) {
-    helpCallback = cb;
+
+size_t CL_serialize(const CL_Args* args, void* buf, size_t cap) {
+    // Compute the size first (passing no image), and only write if it all fits
+    if (buf) {
+        size_t size = CL_serialize(args, NULL, 0);
+        if (size > cap) {
+            return size;
+        }
+    }
+    size_t options_offset = alignUp(sizeof(CL_ImageHeader));
+    size_t values_offset = options_offset + args->option_count * sizeof(CL_FlagOption);
+    size_t set_offset = values_offset + args->value_count * sizeof(char*);
+    size_t kinds_offset = set_offset + (args->option_count / 64 + 1) * sizeof(uint64_t);
+    // List arrays come before the strings, so that the image still ends with a string
+    size_t arrays_used = alignUp(kinds_offset + args->option_count);
+    size_t used = arrays_used;
+    for (uint32_t i = 0; i < args->option_count; i++) {
+        uint8_t kind = valueKind(args->schema, i);
+        if (kind >= KIND_STRING_LIST) {
+            used += alignUp(args->options[i].value.list.count * kindItemSize(kind));
+        }
+    }
+
+    char* image = buf;
+    CL_ImageHeader header = {
+        .magic = IMAGE_MAGIC,
+        .option_count = args->option_count,
+        .schemaHash = schemaHash(args->schema),
+        .value_count = args->value_count,
+        .error_count = args->error_count,
+        .help_requested = args->help_requested,
+    };
+    header.path = imageString(image, cap, &used, args->path);
+    for (uint32_t i = 0; i < args->option_count; i++) {
+        CL_FlagOption option = args->options[i];
+        option.value = CL_flagAt(args, (CL_FlagId)i);
+        uint8_t kind = valueKind(args->schema, i);
+        option.flag = (const char*)(uintptr_t)imageString(image, cap, &used, option.flag);
+        if (kind == KIND_STRING) {
+            option.value.string = (char*)(uintptr_t)imageString(image, cap, &used, option.value.string);
+        } else if (kind >= KIND_STRING_LIST && option.value.list.count > 0) {
+            uint32_t count = option.value.list.count;
+            size_t array_offset = arrays_used;
+            arrays_used += alignUp(count * kindItemSize(kind));
+            if (kind == KIND_STRING_LIST) {
+                header.string_items += count;
+                for (uint32_t j = 0; j < count; j++) {
+                    char* string = (char*)(uintptr_t)imageString(image, cap, &used, option.value.list.strings[j]);
+                    if (image) {
+                        memcpy(image + array_offset + j * sizeof(char*), &string, sizeof(string));
+                    }
+                }
+            } else if (image) {
+                memcpy(image + array_offset, option.value.list.strings, count * kindItemSize(kind));
+            }
+            option.value.list.strings = (char**)(uintptr_t)array_offset;
+        }
+        if (image) {
+            memcpy(image + options_offset + i * sizeof(CL_FlagOption), &option, sizeof(option));
+            image[kinds_offset + i] = kind;
+        }
+    }
+    // Only the bits of the options (the constraints' choice terms may follow them)
+    for (uint32_t w = 0; image && w <= args->option_count / 64; w++) {
+        uint64_t word = args->set && w < (args->option_count + 63) / 64 ? args->set[w] : 0;
+        if (w == args->option_count / 64) {
+            word &= (1ull << (args->option_count & 63)) - 1;
+        }
+        memcpy(image + set_offset + w * sizeof(uint64_t), &word, sizeof(word));
+    }
+    for (uint32_t i = 0; i < args->value_count; i++) {
+        char* value = (char*)(uintptr_t)imageString(image, cap, &used, args->values[i]);
+        if (image) {
+            memcpy(image + values_offset + i * sizeof(char*), &value, sizeof(value));
+        }
+    }
+    header.size = used;
+    if (image) {
+        memcpy(image, &header, sizeof(header));
+    }
+    return used;
 }
 
-CL_Args CL_parse(int argc, char* argv[], const CL_Schema schema) {
-    size_t value_cap = DEFAULT_VALUE_CAP;
-    size_t option_cap = 0;
+// Size of the table of a header's image
+static size_t imageTableSize(const CL_ImageHeader* header) {
+    return (size_t)header->option_count * sizeof(CL_FlagOption) + (size_t)(header->value_count + header->string_items) * sizeof(char*);
+}
 
-    bool schemaDefined = schema != NULL;
+size_t CL_deserializeTableSize(const void* buf, size_t len) {
+    const CL_ImageHeader* header = buf;
+    if (len < sizeof(CL_ImageHeader) || header->magic != IMAGE_MAGIC || header->string_items > header->size) {
+        return 0;
+    }
+    return imageTableSize(header);
+}
 
-    // Count options in schema (if defined)
-    if (schemaDefined) {
-        while (schema[option_cap].type != END) {
-            option_cap++;
-        };
-    } else {
-        option_cap = DEFAULT_OPTIONS_CAP;
+bool CL_deserialize(const void* buf, size_t len, const CL_Schema schema, CL_Args* args, void* table, size_t table_size) {
+    const char* image = buf;
+    const CL_ImageHeader* header = buf;
+    size_t options_offset = alignUp(sizeof(CL_ImageHeader));
+    if (len < options_offset || header->magic != IMAGE_MAGIC || header->size > len ||
+        header->schemaHash != schemaHash(schema) || (schema != NULL) != (header->schemaHash != 0)) {
+        return false;
+    }
+    size_t values_offset = options_offset + (size_t)header->option_count * sizeof(CL_FlagOption);
+    size_t set_offset = values_offset + (size_t)header->value_count * sizeof(char*);
+    size_t kinds_offset = set_offset + (size_t)(header->option_count / 64 + 1) * sizeof(uint64_t);
+    if (kinds_offset + header->option_count > header->size || header->string_items > header->size || table_size < imageTableSize(header)) {
+        return false;
     }
 
-    // Define args object to return
-    CL_Args args = {
-        .path = argc > 0 ? argv[0] : "",
-        .option_count = 0,
-        .value_count = 0,
-        .options = calloc(option_cap, sizeof(CL_FlagOption)),
-        .values = calloc(value_cap, sizeof(char*)),
+    const CL_FlagOption* image_options = (const CL_FlagOption*)(image + options_offset);
+    const uintptr_t* image_values = (const uintptr_t*)(image + values_offset);
+    if (header->path >= header->size || image[header->size - 1] != '\0') {
+        return false;
+    }
+    // The pointers of the args go in the table: the options, the values, then the items of the string lists
+    CL_FlagOption* options = table;
+    char** values = (char**)(options + header->option_count);
+    char** string_items = values + header->value_count;
+    uint64_t string_items_left = header->string_items;
+
+    // Resolve the offsets, checking that every string and array is inside the image (the last
+    // string ends the image, so all are terminated)
+    size_t data_offset = kinds_offset + header->option_count;
+#define IN_IMAGE(offset) ((offset) == 0 || (offset) - data_offset < header->size - data_offset)
+#define RESOLVE(offset) ((offset) ? (char*)image + (offset) : NULL)
+    for (uint32_t i = 0; i < header->option_count; i++) {
+        uint8_t kind = image[kinds_offset + i];
+        CL_FlagOption option = image_options[i];
+        uintptr_t flag = (uintptr_t)option.flag;
+        if (kind != valueKind(schema, i) || !IN_IMAGE(flag) || (kind == KIND_STRING && !IN_IMAGE((uintptr_t)option.value.string))) {
+            return false;
+        }
+        option.flag = RESOLVE(flag);
+        if (kind == KIND_STRING) {
+            option.value.string = RESOLVE((uintptr_t)option.value.string);
+        } else if (kind >= KIND_STRING_LIST && option.value.list.count > 0) {
+            uint32_t count = option.value.list.count;
+            uintptr_t array_offset = (uintptr_t)option.value.list.strings;
+            if (!IN_IMAGE(array_offset) || array_offset % sizeof(double) != 0 || count > (header->size - array_offset) / kindItemSize(kind)) {
+                return false;
+            }
+            if (kind == KIND_STRING_LIST) {
+                if (count > string_items_left) {
+                    return false;
+                }
+                const uintptr_t* strings = (const uintptr_t*)(image + array_offset);
+                for (uint32_t j = 0; j < count; j++) {
+                    if (!IN_IMAGE(strings[j])) {
+                        return false;
+                    }
+                    string_items[j] = RESOLVE(strings[j]);
+                }
+                option.value.list.strings = string_items;
+                string_items += count;
+                string_items_left -= count;
+            } else {
+                // Numbers are read from the image itself
+                option.value.list.strings = (char**)RESOLVE(array_offset);
+            }
+        }
+        options[i] = option;
+    }
+    for (uint32_t i = 0; i < header->value_count; i++) {
+        if (!IN_IMAGE(image_values[i])) {
+            return false;
+        }
+        values[i] = RESOLVE(image_values[i]);
+    }
+#undef RESOLVE
+#undef IN_IMAGE
+
+    *args = (CL_Args){
+        .path = header->path ? (char*)image + header->path : "",
+        .option_count = header->option_count,
+        .value_count = header->value_count,
+        .options = options,
+        .values = values,
+        .schema = schema,
+        .error_count = header->error_count,
+        .help_requested = header->help_requested,
+        .arena = NULL,
+        // Only read (by CL_isSet)
+        .set = schema ? (uint64_t*)(image + set_offset) : NULL,
     };
+    return true;
+}
+
+// BATCH PARSING
+
+// Work of one batch thread: a contiguous range of lines, parsed into a single arena
+typedef struct {
+    const CL_Compiled* compiled;
+    const CL_Argv* lines;
+    CL_Result* out;
+    size_t count;
+    pthread_t thread;
+    bool started;
+} CL_BatchWork;
+
+static void* parseBatchRange(void* data) {
+    CL_BatchWork* work = data;
+    if (work->count == 0) {
+        return NULL;
+    }
+    // Errors are only recorded, and help stops parsing of the line
+    CL_Context ctx = {.collectErrors = true};
+    // Size the arena for all the lines of the range
+    size_t capacity = 0;
+    for (size_t i = 0; i < work->count; i++) {
+        capacity += parseSize(&ctx, work->lines[i].argc, work->compiled);
+    }
+    CL_Arena* arena = arenaCreate(&defaultAllocator, capacity);
+    for (size_t i = 0; i < work->count; i++) {
+        CL_Result* result = &work->out[i];
+        *result = (CL_Result){0};
+        result->args = parseInto(&ctx, arena, work->lines[i].argc, work->lines[i].argv, work->compiled, &result->error);
+        result->args.arena = NULL;
+        result->ok = result->args.error_count == 0;
+    }
+    // The first result of the range owns the arena
+    work->out[0].arena = arena;
+    return NULL;
+}
+
+void CL_parseBatch(const CL_Compiled* compiled, const CL_Argv* lines, size_t n, CL_Result* out, unsigned threads) {
+    if (threads == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cpus > 0 ? (unsigned)cpus : 1;
+    }
+    if (threads > n) {
+        threads = n > 0 ? (unsigned)n : 1;
+    }
 
-    if (!args.options || !args.values) {
+    CL_BatchWork* work = malloc(threads * sizeof(CL_BatchWork));
+    if (!work) {
         perror("[CLargs] malloc");
         abort();
     }
-
-    // Add the schema options as unset in the args
-    if (schemaDefined) {
-        while (args.option_count < option_cap) {
-            CL_FlagOption option = {
-                .flag = schema[args.option_count].name,
-            };
-            switch (schema[args.option_count].type) {
-                case HELP:
-                case BOOLEAN:
-                    option.value.boolean = false;
-                    break;
-                case STRING:
-                    if (schema[args.option_count].strOptions.oneOf[0]) {
-                        option.value.string = schema[args.option_count].strOptions.oneOf[0];
-                    } else {
-                        option.value.string = schema[args.option_count].strOptions.defaultValue;
-                    }
-                    break;
-                case INT:
-                    option.value.integer = schema[args.option_count].intOptions.defaultValue;
-                    break;
-                case DOUBLE:
-                    option.value.number = schema[args.option_count].doubleOptions.defaultValue;
-                    break;
-                case END:  // Unreachable
-                    break;
+    // Split the lines into contiguous ranges, running the first one on this thread
+    size_t start = 0;
+    for (unsigned t = 0; t < threads; t++) {
+        size_t count = n / threads + (t < n % threads ? 1 : 0);
+        work[t] = (CL_BatchWork){
+            .compiled = compiled,
+            .lines = lines + start,
+            .out = out + start,
+            .count = count,
+        };
+        start += count;
+        if (t > 0) {
+            work[t].started = pthread_create(&work[t].thread, NULL, parseBatchRange, &work[t]) == 0;
+            if (!work[t].started) {
+                // Couldn't start a thread; do its work here instead
+                parseBatchRange(&work[t]);
             }
-            args.options[args.option_count++] = option;
         }
     }
+    parseBatchRange(&work[0]);
+    for (unsigned t = 1; t < threads; t++) {
+        if (work[t].started) {
+            pthread_join(work[t].thread, NULL);
+        }
+    }
+    free(work);
+}
 
-    // Process user arguments
-    for (int a = 1; a < argc; a++) {
-        if (argv[a][0] == '-' && argv[a][1] != '\0' && (schemaDefined || argv[a][1] == '-')) {
-            // Is a flag
-            if (schemaDefined) {
-                // Schema defined, find option in schema
-                size_t flag_index = SIZE_MAX;
-                // Check if the flag is in short mode
-                if (argv[a][1] != '-') {
-                    // If there is more than 1 short flag, look for them all
-                    if (argv[a][2] != '\0') {
-                        for (int f = 1; argv[a][f] != '\0'; f++) {
-                            for (int i = 0; schema[i].type != END; i++) {
-                                if (argv[a][f] == schema[i].abbr) {
-                                    // Grouped flags must be boolean (which will then be set to true)
-                                    if (schema[i].type != BOOLEAN) {
-                                        char flagString[2] = {argv[a][f], '\0'};
-                                        parseErrorCallback(flagString, "Grouped flag not a boolean option");
-                                        continue;
-                                    }
-                                    args.options[i].value.boolean = true;
-                                    break;
-                                }
-                            }
-                        }
-                        // Continue to next flag
-                        continue;
-                    } else {
-                        // Just one flag, look for its abbreviation
-                        for (int i = 0; schema[i].type != END; i++) {
-                            if (argv[a][1] == schema[i].abbr) {
-                                flag_index = i;
-                                break;
-                            }
-                        }
-                    }
-                } else {
-                    // Long mode, look for the flag using strcmp
-                    for (int i = 0; schema[i].type != END; i++) {
-                        if (strcmp(argv[a] + 2, schema[i].name) == 0) {
-                            flag_index = i;
-                            break;
-                        }
-                    }
-                }
-                // Check if the flag has been found
-                if (flag_index == SIZE_MAX) {
-                    parseErrorCallback(argv[a], "Unknown option");
-                    continue;
-                }
-                // Process the flag based on its type
-                char* string_value = "";
-                switch (schema[flag_index].type) {
-                    case HELP:
-                        if (helpCallback(schema, args.path)) {
-                            exit(0);
-                        };
-                        break;
-                    case BOOLEAN:
-                        args.options[flag_index].value.boolean = true;
-                        break;
-                    case STRING:
-                        // If the next arg is not a flag, treat it as the value
-                        if (a < argc - 1 && (argv[a + 1][0] != '-' || argv[a + 1][1] != '-')) {
-                            string_value = argv[++a];
-                        }
-                        if (string_value[0] == 0 && !schema[flag_index].strOptions.optional) {
-                            parseErrorCallback(schema[flag_index].name, "Expected value after flag");
-                            continue;
-                        }
-                        if (schema[flag_index].strOptions.oneOf[0]) {
-                            bool equalsOneOfOptions = false;
-                            for (int o = 0; schema[flag_index].strOptions.oneOf[o]; o++) {
-                                if (strcmp(string_value, schema[flag_index].strOptions.oneOf[o]) == 0) {
-                                    equalsOneOfOptions = true;
-                                    break;
-                                }
-                            }
-                            if (!equalsOneOfOptions) {
-                                parseErrorCallback(schema[flag_index].name, "invalid option");
-                                continue;
-                            }
-                        }
-                        args.options[flag_index].value.string = string_value;
-                        break;
-                    case INT:
-                        // If the next arg is not a flag, treat it as the value
-                        if (a < argc - 1 && (argv[a + 1][0] != '-' || argv[a + 1][1] != '-')) {
-                            string_value = argv[++a];
-                        }
-                        if (string_value[0] == 0) {
-                            parseErrorCallback(schema[flag_index].name, "Expected value after flag");
-                            continue;
-                        }
-                        // Compute the specified base and sign
-                        int base = 10;
-                        int32_t sign = 1;
-                        if (string_value[0] == '-') {
-                            sign = -1;
-                            string_value = string_value + 1;
-                        }
-                        if (string_value[0] == '0') {
-                            switch (string_value[1]) {
-                                case 'x':
-                                case 'X':
-                                    base = 16;
-                                    string_value = string_value + 2;
-                                    break;
-                                case 'b':
-                                case 'B':
-                                    base = 2;
-                                    string_value = string_value + 2;
-                                    break;
-                                case 'o':
-                                case 'O':
-                                    base = 8;
-                                    string_value = string_value + 2;
-                                    break;
-                            }
-                        }
-                        // Convert the actual number
-                        int32_t integer_value = (int32_t)strtol(string_value, NULL, base) * sign;
-                        // Check if it is out of the range provided by the schema
-                        if (schema[flag_index].intOptions.minValue != 0 || schema[flag_index].intOptions.maxValue != 0) {
-                            if (integer_value < schema[flag_index].intOptions.minValue || integer_value > schema[flag_index].intOptions.maxValue) {
-                                parseErrorCallback(schema[flag_index].name, "Value out of range");
-                                continue;
-                            }
-                        }
+void CL_freeBatch(CL_Result* results, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        if (results[i].arena) {
+            arenaFree(results[i].arena);
+            results[i].arena = NULL;
+        }
+    }
+}
 
-                        args.options[flag_index].value.integer = integer_value;
-                        break;
-                    case DOUBLE:
-                        // If the next arg is not a flag, treat it as the value
-                        if (a < argc - 1 && (argv[a + 1][0] != '-' || argv[a + 1][1] != '-')) {
-                            string_value = argv[++a];
-                        }
-                        if (string_value[0] == 0) {
-                            parseErrorCallback(schema[flag_index].name, "Expected value after flag");
-                            continue;
-                        }
-                        // Convert the actual number
-                        double numeric_value = strtod(string_value, NULL);
-                        // Check if it is invalid
-                        if (!isfinite(numeric_value)) {
-                            parseErrorCallback(schema[flag_index].name, "Invalid value");
-                            continue;
-                        }
-                        // Check if it is out of the range provided by the schema
-                        if (schema[flag_index].doubleOptions.minValue != 0.0 || schema[flag_index].doubleOptions.maxValue != 0.0) {
-                            if (numeric_value < schema[flag_index].doubleOptions.minValue || numeric_value > schema[flag_index].doubleOptions.maxValue) {
-                                parseErrorCallback(schema[flag_index].name, "Value out of range");
-                                continue;
-                            }
-                        }
-                        args.options[flag_index].value.number = numeric_value;
-                        break;
-                    case END:  // Unreachable
-                        break;
-                }
-            } else {
-                // No schema defined; create the option object with a string value
-                CL_FlagOption option = {
-                    .flag = argv[a] + 2,
-                    .value.string = "",
-                };
-                // If the next argument is not an option flag, treat it as the value for this option
-                if (a < argc - 1 && (argv[a + 1][0] != '-' || argv[a + 1][1] != '-')) {
-                    option.value.string = argv[++a];
-                }
-                // Add to options (increasing capacity if needed)
-                if (args.option_count == option_cap) {
-                    size_t new_option_cap = option_cap + 2;
-                    CL_FlagOption* new_options_ptr = reallocarray(args.options, new_option_cap, sizeof(CL_FlagOption));
-                    if (!new_options_ptr) {
-                        perror("[CLargs] malloc");
-                        abort();
-                    }
-                    args.options = new_options_ptr;
-                }
-                args.options[args.option_count] = option;
-                args.option_count++;
+bool CL_readArgvLines(const char* path, CL_ArgvList* list) {
+    *list = (CL_ArgvList){0};
+    CL_Arena* arena = arenaCreate(&defaultAllocator, 0);
+    size_t size;
+    char* data = mapResponseFile(arena, path, &size);
+    if (!data) {
+        arenaFree(arena);
+        return false;
+    }
+
+    // Tokenize the lines into one pool of arguments (NULL-terminated per line), recording
+    // where each line starts; the argv pointers are set once the pool stops moving
+    size_t token_cap = 64, token_count = 0;
+    size_t line_cap = 16;
+    char** tokens = arenaAlloc(arena, token_cap * sizeof(char*));
+    size_t* starts = malloc(line_cap * sizeof(size_t));
+    int* counts = malloc(line_cap * sizeof(int));
+    if (!starts || !counts) {
+        perror("[CLargs] malloc");
+        abort();
+    }
+    char* end = data + size;
+    for (char* line = data; line < end;) {
+        char* line_end = memchr(line, '\n', end - line);
+        if (!line_end) {
+            line_end = end;
+        }
+        size_t start = token_count;
+        char* cursor = line;
+        char* token;
+        while (true) {
+            token = nextResponseToken(&cursor, line_end);
+            // Leave room for the token and the line's NULL terminator
+            if (token_count + 2 > token_cap) {
+                tokens = arenaGrow(arena, tokens, token_cap * sizeof(char*), token_cap * 2 * sizeof(char*));
+                token_cap *= 2;
             }
-        } else {
-            // Not a flag, just a value, copy to the values (increasing capacity if needed)
-            if (args.value_count == value_cap) {
-                size_t new_value_cap = value_cap + 2;
-                char** new_values_ptr = reallocarray(args.values, new_value_cap, sizeof(char*));
-                if (!new_values_ptr) {
+            if (!token) {
+                break;
+            }
+            tokens[token_count++] = token;
+        }
+        if (token_count > start) {
+            tokens[token_count++] = NULL;
+            if (list->count == line_cap) {
+                line_cap *= 2;
+                starts = realloc(starts, line_cap * sizeof(size_t));
+                counts = realloc(counts, line_cap * sizeof(int));
+                if (!starts || !counts) {
                     perror("[CLargs] malloc");
                     abort();
                 }
-                args.values = new_values_ptr;
             }
-            args.values[args.value_count] = argv[a];
-            args.value_count++;
+            starts[list->count] = start;
+            counts[list->count] = (int)(token_count - start - 1);
+            list->count++;
         }
+        line = line_end + 1;
     }
 
-    return args;
+    list->lines = arenaAlloc(arena, list->count * sizeof(CL_Argv));
+    for (size_t i = 0; i < list->count; i++) {
+        list->lines[i] = (CL_Argv){.argc = counts[i], .argv = tokens + starts[i]};
+    }
+    free(starts);
+    free(counts);
+    list->arena = arena;
+    return true;
+}
+
+void CL_freeArgvLines(CL_ArgvList list) {
+    if (list.arena) {
+        arenaFree(list.arena);
+    }
 }
 
 CL_FlagValue CL_flag(char* flag, CL_Args args) {
     for (uint32_t i = 0; i < args.option_count; i++) {
         if (strcmp(flag, args.options[i].flag) == 0) {
-            return args.options[i].value;
+            return CL_flagAt(&args, (CL_FlagId)i);
         }
     }
 
@@ -403,7 +4171,54 @@ CL_FlagValue CL_flag(char* flag, CL_Args args) {
     return (CL_FlagValue){.string = NULL};
 }
 
+CL_FlagId CL_flagId(const CL_Schema schema, const char* name) {
+    for (CL_FlagId i = 0; schema[i].type != END; i++) {
+        if (strcmp(name, schema[i].name) == 0) {
+            return i;
+        }
+    }
+    return CL_NO_FLAG;
+}
+
+CL_FlagId CL_compiledFlagId(const CL_Compiled* compiled, const char* name) {
+    size_t i = findLongOption(compiled, name);
+    return i == SIZE_MAX ? CL_NO_FLAG : (CL_FlagId)i;
+}
+
+CL_FlagValue CL_flagAt(const CL_Args* args, CL_FlagId id) {
+    CL_FlagValue value;
+    CL_flagChecked(args, id, &value);
+    return value;
+}
+
+CL_ErrorCode CL_flagChecked(const CL_Args* args, CL_FlagId id, CL_FlagValue* value) {
+    if (id < 0 || (uint32_t)id >= args->option_count) {
+        *value = (CL_FlagValue){.string = NULL};
+        return CL_ERR_UNKNOWN_OPTION;
+    }
+    CL_FlagValue* stored = &args->options[id].value;
+    uint64_t bit = 1ull << (id & 63);
+    if (!args->unconverted || !(args->unconverted[id >> 6] & bit)) {
+        *value = *stored;
+        return CL_ERR_NONE;
+    }
+    // Convert a value parsed lazily, keeping it in place of the string if it is valid
+    CL_ErrorCode error = convertValue(args->compiled, id, stored->string, value);
+    if (error) {
+        *value = defaultValue(&args->schema[id]);
+        return error;
+    }
+    *stored = *value;
+    args->unconverted[id >> 6] &= ~bit;
+    return CL_ERR_NONE;
+}
+
+bool CL_isSet(const CL_Args* args, CL_FlagId id) {
+    return args->set && id >= 0 && (uint32_t)id < args->option_count && (args->set[id >> 6] >> (id & 63) & 1);
+}
+
 void CL_free(CL_Args args) {
-    free(args.options);
-    free(args.values);
+    if (args.arena) {
+        arenaFree(args.arena);
+    }
 }
\ No newline at end of file
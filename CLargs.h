@@ -22,8 +22,6 @@ extern "C" {
 
 // SCHEMA DEFINITIONS
 
-// Maximum possibilities for a "one of" option value
-#define CL_MAX_ONEOF_OPTIONS 0xF
 // Macro to format options into the proper schema (appending end)
 #define CL_DEFINESCHEMA(...) \
     {                        \
@@ -34,76 +32,147 @@ extern "C" {
 // Help option
 #define OPTION_HELP() {.name = "help", .type = HELP, .description = "Display the help menu"}
 // Boolean flag option (either there or not)
-#define OPTION_BOOLEAN(_name, _abbr, _desc) \
-    {                                       \
-        .name = _name,                      \
-        .abbr = _abbr,                      \
-        .type = BOOLEAN,                    \
-        .description = _desc,               \
-    }
+#define OPTION_BOOLEAN(...) {CL_FIELDS_BOOLEAN(__VA_ARGS__)}
 // Integer option (can have min and max)
-#define OPTION_INT(_name, _abbr, _desc, _min, _max, _default) \
-    {                                                         \
-        .name = _name,                                        \
-        .abbr = _abbr,                                        \
-        .type = INT,                                          \
-        .description = _desc,                                 \
-        .intOptions = {                                       \
-            .minValue = _min,                                 \
-            .maxValue = _max,                                 \
-            .defaultValue = _default                          \
-        }                                                     \
-    }
+#define OPTION_INT(...) {CL_FIELDS_INT(__VA_ARGS__)}
 // Double option (can have min and max)
-#define OPTION_DOUBLE(_name, _abbr, _desc, _min, _max, _default) \
-    {                                                            \
-        .name = _name,                                           \
-        .abbr = _abbr,                                           \
-        .type = DOUBLE,                                          \
-        .description = _desc,                                    \
-        .doubleOptions = {                                       \
-            .minValue = _min,                                    \
-            .maxValue = _max,                                    \
-            .defaultValue = _default                             \
-        }                                                        \
-    }
+#define OPTION_DOUBLE(...) {CL_FIELDS_DOUBLE(__VA_ARGS__)}
 // String option
-#define OPTION_STRING(_name, _abbr, _desc, _default) \
-    {                                                \
-        .name = _name,                               \
-        .abbr = _abbr,                               \
-        .type = STRING,                              \
-        .description = _desc,                        \
-        .strOptions = {                              \
-            .optional = false,                       \
-            .oneOf = {NULL},                         \
-            .defaultValue = _default                 \
-        }                                            \
-    }
+#define OPTION_STRING(...) {CL_FIELDS_STRING(__VA_ARGS__)}
 // Optional option (may optionally be followed by a value)
-#define OPTION_OPTIONAL(_name, _abbr, _desc, _default) \
-    {                                                  \
-        .name = _name,                                 \
-        .abbr = _abbr,                                 \
-        .type = STRING,                                \
-        .description = _desc,                          \
-        .strOptions = {                                \
-            .optional = true,                          \
-            .oneOf = {NULL},                           \
-            .defaultValue = _default                   \
-        }                                              \
-    }
+#define OPTION_OPTIONAL(...) {CL_FIELDS_OPTIONAL(__VA_ARGS__)}
 // "One of" option (may be one of the provided choices)
-#define OPTION_ONEOF(_name, _abbr, _desc, ...) \
+#define OPTION_ONEOF(...) {CL_FIELDS_ONEOF(__VA_ARGS__)}
+// "One of" option matching its choices as given by CL_MATCH_* flags (eg ignoring case)
+#define OPTION_ONEOF_MATCH(...) {CL_FIELDS_ONEOF_MATCH(__VA_ARGS__)}
+// String list option (every occurrence of the flag adds a value)
+#define OPTION_STRING_LIST(...) {CL_FIELDS_STRING_LIST(__VA_ARGS__)}
+// Integer list option (every value can have min and max)
+#define OPTION_INT_LIST(...) {CL_FIELDS_INT_LIST(__VA_ARGS__)}
+// Double list option (every value can have min and max)
+#define OPTION_DOUBLE_LIST(...) {CL_FIELDS_DOUBLE_LIST(__VA_ARGS__)}
+// Subcommand (selected by the first value, the arguments after it are parsed with its own schema)
+#define OPTION_SUBCOMMAND(_name, _desc, _schema) \
+    {                                            \
+        .name = _name,                           \
+        .type = SUBCOMMAND,                      \
+        .description = _desc,                    \
+        .subcommand = {                          \
+            .schema = _schema,                   \
+        }                                        \
+    }
+// Option of the given type (BOOLEAN, INT, DOUBLE, STRING, OPTIONAL, ONEOF, ONEOF_MATCH, STRING_LIST,
+// INT_LIST or DOUBLE_LIST, followed by the arguments of its OPTION_* macro) that can also be set with an
+// environment variable and a config file key (either may be NULL), see CL_parseLayered
+#define OPTION_LAYERED(_env, _key, _type, ...) \
     {                                          \
-        .name = _name,                         \
-        .abbr = _abbr,                         \
-        .type = STRING,                        \
-        .description = _desc,                  \
-        .strOptions = {                        \
-            .optional = false,                 \
-            .oneOf = {__VA_ARGS__},            \
-        }                                      \
+        CL_FIELDS_##_type(__VA_ARGS__),        \
+        .env = _env,                           \
+        .configKey = _key,                     \
+    }
+// Constraints between the options of the schema (CL_REQUIRES, CL_CONFLICTS, CL_EXACTLY_ONE_OF or
+// CL_AT_LEAST_ONE_OF), checked at the end of every parse. Must be the last entry of the schema
+#define OPTION_CONSTRAINTS(...)                                                           \
+    {                                                                                     \
+        .type = END,                                                                      \
+        .constraints = (const CL_Constraint[]){__VA_ARGS__, {.kind = CL_CONSTRAINT_END}}, \
+    }
+// If the first option is set, all the others must be set
+#define CL_REQUIRES(...) {.kind = CL_CONSTRAINT_REQUIRES, .options = (const char* const[]){__VA_ARGS__, NULL}}
+// If the first option is set, none of the others can be set
+#define CL_CONFLICTS(...) {.kind = CL_CONSTRAINT_CONFLICTS, .options = (const char* const[]){__VA_ARGS__, NULL}}
+// Exactly one of the options must be set
+#define CL_EXACTLY_ONE_OF(...) {.kind = CL_CONSTRAINT_EXACTLY_ONE, .options = (const char* const[]){__VA_ARGS__, NULL}}
+// At least one of the options must be set
+#define CL_AT_LEAST_ONE_OF(...) {.kind = CL_CONSTRAINT_AT_LEAST_ONE, .options = (const char* const[]){__VA_ARGS__, NULL}}
+
+// Fields of the OPTION_* macros
+#define CL_FIELDS_BOOLEAN(_name, _abbr, _desc) \
+    .name = _name,                             \
+    .abbr = _abbr,                             \
+    .type = BOOLEAN,                           \
+    .description = _desc
+#define CL_FIELDS_INT(_name, _abbr, _desc, _min, _max, _default) \
+    .name = _name,                                               \
+    .abbr = _abbr,                                               \
+    .type = INT,                                                 \
+    .description = _desc,                                        \
+    .intOptions = {                                              \
+        .minValue = _min,                                        \
+        .maxValue = _max,                                        \
+        .defaultValue = _default                                 \
+    }
+#define CL_FIELDS_DOUBLE(_name, _abbr, _desc, _min, _max, _default) \
+    .name = _name,                                                  \
+    .abbr = _abbr,                                                  \
+    .type = DOUBLE,                                                 \
+    .description = _desc,                                           \
+    .doubleOptions = {                                              \
+        .minValue = _min,                                           \
+        .maxValue = _max,                                           \
+        .defaultValue = _default                                    \
+    }
+#define CL_FIELDS_STRING(_name, _abbr, _desc, _default) \
+    .name = _name,                                      \
+    .abbr = _abbr,                                      \
+    .type = STRING,                                     \
+    .description = _desc,                               \
+    .strOptions = {                                     \
+        .optional = false,                              \
+        .oneOf = NULL,                                  \
+        .defaultValue = _default                        \
+    }
+#define CL_FIELDS_OPTIONAL(_name, _abbr, _desc, _default) \
+    .name = _name,                                        \
+    .abbr = _abbr,                                        \
+    .type = STRING,                                       \
+    .description = _desc,                                 \
+    .strOptions = {                                       \
+        .optional = true,                                 \
+        .oneOf = NULL,                                    \
+        .defaultValue = _default                          \
+    }
+#define CL_FIELDS_ONEOF(_name, _abbr, _desc, ...)          \
+    .name = _name,                                         \
+    .abbr = _abbr,                                         \
+    .type = STRING,                                        \
+    .description = _desc,                                  \
+    .strOptions = {                                        \
+        .optional = false,                                 \
+        .oneOf = (const char* const[]){__VA_ARGS__, NULL}, \
+    }
+#define CL_FIELDS_ONEOF_MATCH(_name, _abbr, _desc, _match, ...) \
+    .name = _name,                                               \
+    .abbr = _abbr,                                               \
+    .type = STRING,                                              \
+    .description = _desc,                                        \
+    .strOptions = {                                              \
+        .optional = false,                                       \
+        .match = _match,                                         \
+        .oneOf = (const char* const[]){__VA_ARGS__, NULL},       \
+    }
+#define CL_FIELDS_STRING_LIST(_name, _abbr, _desc) \
+    .name = _name,                                 \
+    .abbr = _abbr,                                 \
+    .type = STRING_LIST,                           \
+    .description = _desc
+#define CL_FIELDS_INT_LIST(_name, _abbr, _desc, _min, _max) \
+    .name = _name,                                          \
+    .abbr = _abbr,                                          \
+    .type = INT_LIST,                                       \
+    .description = _desc,                                   \
+    .intOptions = {                                         \
+        .minValue = _min,                                   \
+        .maxValue = _max,                                   \
+    }
+#define CL_FIELDS_DOUBLE_LIST(_name, _abbr, _desc, _min, _max) \
+    .name = _name,                                             \
+    .abbr = _abbr,                                             \
+    .type = DOUBLE_LIST,                                       \
+    .description = _desc,                                      \
+    .doubleOptions = {                                         \
+        .minValue = _min,                                      \
+        .maxValue = _max,                                      \
     }
 
 // Enum representing the different types of options
@@ -114,14 +183,48 @@ typedef enum {
     STRING,
     INT,
     DOUBLE,
+    STRING_LIST,
+    INT_LIST,
+    DOUBLE_LIST,
+    SUBCOMMAND,
 } CL_OptionType;
 
+// How the value of a "one of" option is matched to its choices (flags that can be combined).
+// Values are matched to the exact choices by default
+enum {
+    // Ignore the case of ASCII letters
+    CL_MATCH_NOCASE = 1,
+    // Also accept a prefix of a single choice (a choice given in full always matches)
+    CL_MATCH_PREFIX = 2,
+};
+
+// Kinds of constraints between options
+typedef enum {
+    // End of the constraints
+    CL_CONSTRAINT_END,
+    CL_CONSTRAINT_REQUIRES,
+    CL_CONSTRAINT_CONFLICTS,
+    CL_CONSTRAINT_EXACTLY_ONE,
+    CL_CONSTRAINT_AT_LEAST_ONE,
+} CL_ConstraintKind;
+
+// Constraint on the options set explicitly (by the arguments, environment or config file rather
+// than by their default). An option named "name=choice" is a "one of" option set to that choice
+typedef struct CL_Constraint {
+    CL_ConstraintKind kind;
+    // Names of the options (NULL-terminated array)
+    const char* const* options;
+} CL_Constraint;
+
 // Enum representing an option definition in the schema
-typedef struct {
+typedef struct CL_Option {
     const char* name;
     const char abbr;
     const CL_OptionType type;
     const char* description;
+    // Environment variable and config file key that can also set the option (NULL for none)
+    const char* env;
+    const char* configKey;
     union {
         struct {
             int32_t minValue;
@@ -135,9 +238,19 @@ typedef struct {
         } doubleOptions;
         struct {
             bool optional;
-            char* oneOf[CL_MAX_ONEOF_OPTIONS];
+            // How the value is matched to the choices (CL_MATCH_* flags)
+            uint8_t match;
+            // Choices the value must be one of (NULL-terminated array, NULL for any value)
+            const char* const* oneOf;
             char* defaultValue;
         } strOptions;
+        struct {
+            // Schema of the subcommand's arguments (indexed the first time it is selected)
+            const struct CL_Option* schema;
+        } subcommand;
+        // Constraints of the schema, on its END entry (array ending with CL_CONSTRAINT_END, see
+        // OPTION_CONSTRAINTS)
+        const CL_Constraint* constraints;
     };
 } CL_Option;
 
@@ -152,6 +265,21 @@ typedef union {
     int32_t integer;
     char* string;
     double number;
+    // Value of a "one of" option: the choice it matched (as written in the schema, so it is also
+    // the string value) and its index in the choices, eg to switch on
+    struct {
+        char* string;
+        int32_t index;
+    } choice;
+    // Values of a list option, in the order they were passed (a packed array of the item type)
+    struct {
+        union {
+            char** strings;
+            int32_t* integers;
+            double* numbers;
+        };
+        uint32_t count;
+    } list;
 } CL_FlagValue;
 
 // Struct representing an option flag and its value
@@ -160,8 +288,65 @@ typedef struct {
     CL_FlagValue value;
 } CL_FlagOption;
 
-// Args struct returned by CL_parse
+// Handle to an option, equal to its index in the schema (and in CL_Args.options when parsed with that schema)
+typedef int32_t CL_FlagId;
+// Handle value for options that are not in the schema
+#define CL_NO_FLAG ((CL_FlagId)-1)
+
+// Enum representing the kinds of parse errors
+typedef enum {
+    CL_ERR_NONE,
+    // Flag without its value
+    CL_ERR_MISSING_VALUE,
+    // Value that is not one of the choices of a "one of" option
+    CL_ERR_INVALID_CHOICE,
+    CL_ERR_INVALID_NUMBER,
+    CL_ERR_NUMBER_TOO_LARGE,
+    // Number outside the range of the option
+    CL_ERR_OUT_OF_RANGE,
+    CL_ERR_UNKNOWN_OPTION,
+    // Non-boolean option in a group of short flags
+    CL_ERR_GROUPED_NOT_BOOLEAN,
+    // Invalid boolean in the environment or a config file
+    CL_ERR_INVALID_BOOLEAN,
+    CL_ERR_CONFIG_UNREADABLE,
+    // Long flag that is a prefix of several option names
+    CL_ERR_AMBIGUOUS_OPTION,
+    // Inline value ("--flag=value") for an option without a value
+    CL_ERR_UNEXPECTED_VALUE,
+    // Option set without an option it requires
+    CL_ERR_MISSING_REQUIRED,
+    // Option set with an option it conflicts with, or with another of a group only one of which can be set
+    CL_ERR_CONFLICTING_OPTION,
+    // None of a group of options one of which must be set (the flag of the error lists them)
+    CL_ERR_MISSING_ONE_OF,
+} CL_ErrorCode;
+
+// Struct representing a parse error
 typedef struct {
+    // Index in argv of the argument causing the error (-1 for the environment and config file)
+    int argIndex;
+    // Character offset of the error in that argument (eg of the flag in a group of short flags)
+    int offset;
+    // Option handle (CL_NO_FLAG if unknown)
+    CL_FlagId id;
+    CL_ErrorCode code;
+    // Error message (static string)
+    const char* message;
+    // Closest option to an unknown long flag (CL_NO_FLAG if none is close enough)
+    CL_FlagId suggestion;
+    // Option required by or conflicting with the option of a violated constraint (CL_NO_FLAG otherwise)
+    CL_FlagId related;
+} CL_Error;
+
+// Message of an error code (static string)
+const char* CL_errorMessage(CL_ErrorCode code);
+
+// Memory block holding the contents of a CL_Args object
+typedef struct CL_Arena CL_Arena;
+
+// Args struct returned by CL_parse
+typedef struct CL_Args {
     // Program name (argv[0])
     char* path;
     // Number of options in array
@@ -170,8 +355,38 @@ typedef struct {
     uint32_t value_count;
     CL_FlagOption* options;
     char** values;
+    // Schema the arguments were parsed with (NULL without a schema)
+    const CL_Option* schema;
+    // Number of parse errors encountered
+    uint32_t error_count;
+    // Every parse error in argument order (only when parsed with CL_Context.collectErrors, NULL otherwise)
+    CL_Error* errors;
+    // Whether parsing stopped at the help option
+    bool help_requested;
+    // Memory backing the arrays above (released by CL_free)
+    CL_Arena* arena;
+    // Arguments of the selected subcommand (NULL if none), freed with these args. Its error_count
+    // and help_requested are also counted here
+    struct CL_Args* subcommand;
+    // Options whose value is still the argument string, converted on first access (a bitset, NULL
+    // unless parsed with CL_Context.lazy), and the compiled schema to convert them with
+    uint64_t* unconverted;
+    const struct CL_Compiled* compiled;
+    // Options set explicitly, by the arguments, environment or config file rather than by their
+    // default (a bitset indexed by handle, NULL without a schema), see CL_isSet
+    uint64_t* set;
 } CL_Args;
 
+// Memory allocator used for the parse results
+typedef struct {
+    // Allocate a block of memory (aligned for any type), NULL on failure
+    void* (*alloc)(size_t size, void* userData);
+    // Release a block returned by alloc
+    void (*free)(void* ptr, void* userData);
+    // Pointer passed to both functions
+    void* userData;
+} CL_Allocator;
+
 // Type representing parse error callback function
 typedef void (*CL_ParseErrorCallback)(const char* flag, char* msg);
 // Set a custom parse error callback function
@@ -183,13 +398,283 @@ typedef bool (*CL_HelpCallback)(const CL_Schema schema, const char* progname);
 // Set a custom help menu callback
 void CL_setHelpCallback(CL_HelpCallback cb);
 
+// Opaque schema index built by CL_compileSchema, for fast option lookup when parsing
+typedef struct CL_Compiled CL_Compiled;
+// Build a reusable lookup index for a schema (the schema must outlive it)
+CL_Compiled* CL_compileSchema(const CL_Schema schema);
+// Free a compiled schema
+void CL_freeCompiled(CL_Compiled* compiled);
+
+// Output formats of the help menu
+typedef enum {
+    // Plain text, as displayed by the default help callback
+    CL_HELP_TEXT,
+    // Man page (roff)
+    CL_HELP_MAN,
+    CL_HELP_MARKDOWN,
+} CL_HelpFormat;
+// Render the help menu of a schema (without the usage line if progname is NULL), wrapping text
+// descriptions at the given width (0 for no wrapping). Returns a string to release with free(),
+// storing its length in length if not NULL
+char* CL_renderHelp(const CL_Schema schema, const char* progname, CL_HelpFormat format, unsigned width, size_t* length);
+// Text help menu of a compiled schema without the usage line, rendered the first time and kept
+// until the compiled schema is freed. It keeps the wrapping of the first call (of this function or
+// CL_printHelp): the width of standard output's terminal, or none if it is not a terminal, even
+// when it is printed to another file descriptor later
+const char* CL_compiledHelp(const CL_Compiled* compiled);
+// Write the help menu of a compiled schema with its usage line (if progname is not NULL) to a
+// file descriptor in a single system call. Returns false if the write failed
+bool CL_printHelp(int fd, const CL_Compiled* compiled, const char* progname);
+
+// Shells of the completion scripts
+typedef enum {
+    CL_SHELL_BASH,
+    CL_SHELL_ZSH,
+    CL_SHELL_FISH,
+} CL_Shell;
+// Generate a completion script for a program: its flags, abbreviations, choices and subcommands
+// are completed by the script, and the arguments of a subcommand by the program itself (see
+// CL_complete). The #compdef line of zsh can't hold spaces, so it names the program with
+// underscores instead. Returns a string to release with free()
+char* CL_completionScript(const CL_Schema schema, const char* progname, CL_Shell shell);
+// Answer a completion request if argv[1] is "__complete": the candidates for the last argument
+// (given the arguments before it) are written to standard output, one per line. Returns true
+// if it was a completion request, after which the program should exit
+bool CL_complete(int argc, char* argv[], const CL_Compiled* compiled);
+
+// Generate the C source of a parser specialized for a schema (without subcommands, NULL for a
+// schema with some). The source defines <prefix>_Args, with a field per option, and
+// <prefix>_parse(argc, argv, &args), which gives the same values and errors as CL_parseContext
+// with a context without handlers (see codegen/). Returns a string to release with free()
+char* CL_generateParser(const CL_Schema schema, const char* prefix);
+
+// Type representing a context's parse error handler
+typedef void (*CL_ErrorHandler)(const char* flag, const char* msg, void* userData);
+// Type representing a context's help handler.
+//
+// Returns true if parsing should stop after displaying the help menu
+typedef bool (*CL_HelpHandler)(const CL_Schema schema, const char* progname, void* userData);
+
+// Parser context: everything a parse needs besides the arguments and schema, so that
+// parses with different contexts share no state (and may run concurrently)
+typedef struct {
+    // Called for each parse error (NULL to only count errors)
+    CL_ErrorHandler onError;
+    // Called for the help option (NULL to stop parsing without displaying anything)
+    CL_HelpHandler onHelp;
+    // Pointer passed to the handlers
+    void* userData;
+    // Allocator for the results (NULL to use malloc/free)
+    const CL_Allocator* allocator;
+    // Record every error in CL_Args.errors (allocated with the results)
+    bool collectErrors;
+    // Convert and check INT, DOUBLE and "one of" values when they are first read (see
+    // CL_flagChecked) instead of while parsing. The compiled schema must outlive the results.
+    // Reading a value converts it in place, so lazily parsed args must not be read from several
+    // threads at once (unlike args parsed without lazy)
+    bool lazy;
+} CL_Context;
+
 // Parse command-line arguments
 CL_Args CL_parse(int argc, char* argv[], const CL_Schema schema);
-// Get the value of a CL_Args flag
+// Parse command-line arguments using a compiled schema
+CL_Args CL_parseCompiled(int argc, char* argv[], const CL_Compiled* compiled);
+// Parse command-line arguments, allocating the results and the temporary compiled schema with a
+// custom allocator
+CL_Args CL_parseWithAllocator(int argc, char* argv[], const CL_Schema schema, const CL_Allocator* allocator);
+// Parse command-line arguments with a context instead of the global callbacks.
+// Never exits the program: errors are counted in the result, and help sets help_requested
+CL_Args CL_parseContext(const CL_Context* ctx, int argc, char* argv[], const CL_Compiled* compiled);
+// Parse command-line arguments with a context, on top of the environment variables and config file
+// keys named in the schema (see OPTION_LAYERED). The config file (NULL for none) has one
+// "key = value" per line. An option is set by argv, else by the environment, else by the file,
+// else has its default value. Errors in the environment or file are reported with the variable
+// or key as the flag, and an unreadable config file is an error
+CL_Args CL_parseLayered(const CL_Context* ctx, int argc, char* argv[], const CL_Compiled* compiled, const char* configPath);
+// Get the value of a CL_Args flag (converting it on first access if parsed lazily, see CL_flagChecked)
 CL_FlagValue CL_flag(char* flag, CL_Args args);
+
+// Resolve an option name to its handle (CL_NO_FLAG if not found)
+CL_FlagId CL_flagId(const CL_Schema schema, const char* name);
+// Resolve an option name to its handle using a compiled schema
+CL_FlagId CL_compiledFlagId(const CL_Compiled* compiled, const char* name);
+// Find the option whose name is closest to an unknown flag name (within about one edit per 3
+// characters), to suggest it to the user. Returns CL_NO_FLAG if none is close enough
+CL_FlagId CL_suggest(const CL_Compiled* compiled, const char* name);
+// Get the value of a CL_Args flag by handle (NULL string value if out of range), converting it
+// on first access if parsed lazily (see CL_flagChecked)
+CL_FlagValue CL_flagAt(const CL_Args* args, CL_FlagId id);
+// Value of an option from its handle, returning the error of its conversion when the args were
+// parsed lazily (the value is then the option's default). Invalid values are checked on every
+// access, valid ones are converted once. The conversion writes to the args despite the const
+// pointer, so lazily parsed args must not be read concurrently (args parsed without CL_Context.lazy
+// are only read, and can be)
+CL_ErrorCode CL_flagChecked(const CL_Args* args, CL_FlagId id, CL_FlagValue* value);
+// Whether an option was set explicitly (by the arguments, environment or config file), rather
+// than having its default value
+bool CL_isSet(const CL_Args* args, CL_FlagId id);
 // Free the heap allocations of CL_Args object
 void CL_free(CL_Args args);
 
+// SERIALIZATION
+
+// Write a binary image of parse results to buf (if cap is large enough, buf may be NULL to
+// only compute the size), returning the size of the image. The image holds no pointers, and is
+// tagged with a hash of the schema. The arguments of a selected subcommand and the collected
+// errors are not included
+size_t CL_serialize(const CL_Args* args, void* buf, size_t cap);
+// Size of the table CL_deserialize needs for the pointers of an image (0 if buf is not an image)
+size_t CL_deserializeTableSize(const void* buf, size_t len);
+// Restore parse results from an image without writing to it (so it can be a read-only or shared
+// mapping): the pointers of the returned args are stored in table (pointer-aligned, of at least
+// CL_deserializeTableSize bytes), and point into buf. Both must outlive the args, which must not
+// be freed with CL_free. Returns false if the image is invalid, was made with a different schema
+// or the table is too small
+bool CL_deserialize(const void* buf, size_t len, const CL_Schema schema, CL_Args* args, void* table, size_t table_size);
+
+// NUMBER CONVERSION
+
+// Result of a number conversion
+typedef enum {
+    CL_NUM_OK,
+    // No digits
+    CL_NUM_EMPTY,
+    // Invalid or trailing characters
+    CL_NUM_SYNTAX,
+    // Magnitude too large for the type
+    CL_NUM_OVERFLOW,
+} CL_NumResult;
+
+// Convert a whole string to a 64-bit integer, in base 10 or 2/8/16 with a 0b/0o/0x prefix,
+// with optional sign and "_" separators between digits. Independent of the locale
+CL_NumResult CL_strToInt64(const char* str, int64_t* out);
+// Convert a whole string to a finite double (decimal notation with optional exponent and "_"
+// separators between digits, of any length). Independent of the locale, which it neither reads
+// nor changes for other threads
+CL_NumResult CL_strToDouble(const char* str, double* out);
+
+// BATCH PARSING
+
+// Arguments of one command line
+typedef struct {
+    int argc;
+    char** argv;
+} CL_Argv;
+
+// Result of parsing one command line in a batch
+typedef struct {
+    CL_Args args;
+    // Whether the line parsed without errors
+    bool ok;
+    // First error of the line (if not ok)
+    CL_Error error;
+    // Memory of the results (internal, released by CL_freeBatch)
+    CL_Arena* arena;
+} CL_Result;
+
+// Lines of a file, each tokenized into arguments
+typedef struct {
+    CL_Argv* lines;
+    size_t count;
+    // Memory holding the lines and the mapped file
+    CL_Arena* arena;
+} CL_ArgvList;
+
+// Parse many command lines against a compiled schema, on the given number of threads (0 for
+// one per CPU). Errors are recorded in the results (all of them in args.errors) instead of
+// calling any callback, and the help option stops parsing of its line. Results must be
+// released with CL_freeBatch
+void CL_parseBatch(const CL_Compiled* compiled, const CL_Argv* lines, size_t n, CL_Result* out, unsigned threads);
+// Free the results of CL_parseBatch (not with CL_free)
+void CL_freeBatch(CL_Result* results, size_t n);
+// Read a file with one command line (program name and arguments) per line, tokenized in
+// place like response files. Returns false if the file can't be read
+bool CL_readArgvLines(const char* path, CL_ArgvList* list);
+// Free the lines read by CL_readArgvLines
+void CL_freeArgvLines(CL_ArgvList list);
+
+// ITERATOR
+
+// Enum representing the kinds of parse events
+typedef enum {
+    // Value not associated with an option
+    CL_EVENT_VALUE,
+    // Option flag with its (converted) value
+    CL_EVENT_FLAG,
+    // Parse error
+    CL_EVENT_ERROR,
+} CL_EventType;
+
+// Struct representing a single parse event
+typedef struct {
+    CL_EventType type;
+    // Option handle (CL_NO_FLAG for values, unknown options or when parsing without a schema)
+    CL_FlagId id;
+    // Flag name (the flag as passed for errors; NULL for values)
+    const char* flag;
+    // Option value (true for boolean and help options, the single item passed for list options),
+    // or the string of a value event
+    CL_FlagValue value;
+    // Error code, message and character offset in the argument (error events only)
+    CL_ErrorCode code;
+    const char* message;
+    int offset;
+    // Closest option to an unknown long flag (CL_NO_FLAG if none is close enough)
+    CL_FlagId suggestion;
+    // Index in argv of the argument the event comes from (the @file argument for response file contents)
+    int argIndex;
+} CL_Event;
+
+// Number of arguments an iterator classifies at once (a power of 2)
+#define CL_ITER_WINDOW 64
+
+// Iterator state for parsing arguments one event at a time (fields are internal)
+typedef struct {
+    int argc;
+    char** argv;
+    const CL_Compiled* compiled;
+    // Next argument index and argument index of the current token
+    int index;
+    int argIndex;
+    // Remaining grouped short flags of the current argument, and the argument
+    const char* group;
+    const char* groupArg;
+    // Response file being read
+    char* fileCursor;
+    char* fileEnd;
+    // Token read ahead to check for a flag value
+    char* pending;
+    int pendingIndex;
+    // Kind, and long flag name length and hash (with a schema), of the pending and current tokens
+    uint8_t pendingKind;
+    uint8_t kind;
+    uint32_t pendingLength;
+    uint32_t pendingHash;
+    uint32_t nameLength;
+    uint32_t nameHash;
+    // Memory holding the response file mappings
+    CL_Arena* arena;
+    bool ownsArena;
+    // Flag string for grouped flag errors
+    char shortFlag[2];
+    // Leave INT, DOUBLE and "one of" values unconverted (parsing lazily)
+    bool lazy;
+    // Kind, and long flag name length and hash, of the arguments classified ahead (up to
+    // windowEnd, in slots by argument index)
+    int windowEnd;
+    uint8_t kinds[CL_ITER_WINDOW];
+    uint32_t nameLengths[CL_ITER_WINDOW];
+    uint32_t nameHashes[CL_ITER_WINDOW];
+} CL_Iter;
+
+// Start iterating over command-line arguments (compiled may be NULL to parse without a schema)
+CL_Iter CL_iterBegin(int argc, char* argv[], const CL_Compiled* compiled);
+// Read the next event, returning false when all the arguments have been processed.
+// Strings in events stay valid until CL_iterEnd
+bool CL_next(CL_Iter* it, CL_Event* event);
+// Release the resources of an iterator (mapped response files)
+void CL_iterEnd(CL_Iter* it);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,443 @@
+/**
+ * CLargs.hpp
+ * Compile-time schemas for the command-line argument parser (C++20)
+ *
+ * Copyright (C) 2025 Alfio Tomarchio
+ * All rights reserved.
+ *
+ * Use of this source code is governed by a MIT-style license that can be found
+ * in the LICENSE file or at https://opensource.org/licenses/MIT.
+ */
+
+#ifndef CLARGS_HPP
+#define CLARGS_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <tuple>
+#include <utility>
+
+#include "CLargs.h"
+
+namespace cl {
+
+// OPTIONS
+
+// Boolean flag option (either there or not)
+struct Boolean {
+    using value_type = bool;
+    static constexpr CL_OptionType type = BOOLEAN;
+    const char* name;
+    char abbr;
+    const char* description;
+};
+
+// Integer option (min and max both 0 for any value)
+struct Int {
+    using value_type = int32_t;
+    static constexpr CL_OptionType type = INT;
+    const char* name;
+    char abbr;
+    const char* description;
+    int32_t minValue = 0;
+    int32_t maxValue = 0;
+    int32_t defaultValue = 0;
+};
+
+// Double option (min and max both 0 for any value)
+struct Double {
+    using value_type = double;
+    static constexpr CL_OptionType type = DOUBLE;
+    const char* name;
+    char abbr;
+    const char* description;
+    double minValue = 0;
+    double maxValue = 0;
+    double defaultValue = 0;
+};
+
+// String option (optional: may be passed without a value)
+struct String {
+    using value_type = const char*;
+    static constexpr CL_OptionType type = STRING;
+    const char* name;
+    char abbr;
+    const char* description;
+    const char* defaultValue = nullptr;
+    bool optional = false;
+};
+
+// Value of a "one of" option: the choice it matched and its index in the choices
+struct Choice {
+    const char* string;
+    int32_t index;
+    operator const char*() const {
+        return string;
+    }
+};
+
+// "One of" option (may be one of the provided choices, defaulting to the first)
+template <size_t N>
+struct OneOf {
+    using value_type = Choice;
+    static constexpr CL_OptionType type = STRING;
+    const char* name;
+    char abbr;
+    const char* description;
+    // Followed by a null pointer, as the C schema expects
+    std::array<const char*, N + 1> choices;
+    // How values are matched to the choices (CL_MATCH_* flags)
+    uint8_t match = 0;
+};
+
+// String list option (every occurrence adds a value)
+struct StringList {
+    using value_type = std::span<char* const>;
+    static constexpr CL_OptionType type = STRING_LIST;
+    const char* name;
+    char abbr;
+    const char* description;
+};
+
+// Integer list option (min and max both 0 for any value)
+struct IntList {
+    using value_type = std::span<const int32_t>;
+    static constexpr CL_OptionType type = INT_LIST;
+    const char* name;
+    char abbr;
+    const char* description;
+    int32_t minValue = 0;
+    int32_t maxValue = 0;
+};
+
+// Double list option (min and max both 0 for any value)
+struct DoubleList {
+    using value_type = std::span<const double>;
+    static constexpr CL_OptionType type = DOUBLE_LIST;
+    const char* name;
+    char abbr;
+    const char* description;
+    double minValue = 0;
+    double maxValue = 0;
+};
+
+// Help option
+struct Help {
+    using value_type = bool;
+    static constexpr CL_OptionType type = HELP;
+    const char* name = "help";
+    char abbr = 0;
+    const char* description = "Display the help menu";
+};
+
+// Option constructors, mirroring the OPTION_* macros
+constexpr Boolean boolean(const char* name, char abbr, const char* description) {
+    return {name, abbr, description};
+}
+constexpr Int integer(const char* name, char abbr, const char* description, int32_t min, int32_t max, int32_t defaultValue) {
+    return {name, abbr, description, min, max, defaultValue};
+}
+constexpr Double number(const char* name, char abbr, const char* description, double min, double max, double defaultValue) {
+    return {name, abbr, description, min, max, defaultValue};
+}
+constexpr String string(const char* name, char abbr, const char* description, const char* defaultValue) {
+    return {name, abbr, description, defaultValue, false};
+}
+constexpr String optional(const char* name, char abbr, const char* description, const char* defaultValue) {
+    return {name, abbr, description, defaultValue, true};
+}
+template <typename... Choices>
+constexpr OneOf<sizeof...(Choices)> oneOf(const char* name, char abbr, const char* description, Choices... choices) {
+    return {name, abbr, description, {choices..., nullptr}};
+}
+template <typename... Choices>
+constexpr OneOf<sizeof...(Choices)> oneOfMatch(const char* name, char abbr, const char* description, uint8_t match, Choices... choices) {
+    return {name, abbr, description, {choices..., nullptr}, match};
+}
+constexpr StringList stringList(const char* name, char abbr, const char* description) {
+    return {name, abbr, description};
+}
+constexpr IntList intList(const char* name, char abbr, const char* description, int32_t min, int32_t max) {
+    return {name, abbr, description, min, max};
+}
+constexpr DoubleList doubleList(const char* name, char abbr, const char* description, double min, double max) {
+    return {name, abbr, description, min, max};
+}
+constexpr Help help() {
+    return {};
+}
+
+// SCHEMA
+
+// Option name usable as a template argument (eg args.get<"power">())
+template <size_t N>
+struct Name {
+    char chars[N];
+    constexpr Name(const char (&name)[N]) {
+        std::copy_n(name, N, chars);
+    }
+    constexpr std::string_view view() const {
+        return {chars, N - 1};
+    }
+};
+
+// Schema of options, built and checked at compile time
+template <typename... Options>
+struct Schema {
+    static constexpr size_t size = sizeof...(Options);
+    std::tuple<Options...> options;
+
+    constexpr Schema(Options... options) : options(options...) {}
+
+    // Names and abbreviations of the options, in order
+    constexpr std::array<std::string_view, size> names() const {
+        return std::apply([](const auto&... option) { return std::array<std::string_view, size>{std::string_view(option.name)...}; }, options);
+    }
+    constexpr std::array<char, size> abbrs() const {
+        return std::apply([](const auto&... option) { return std::array<char, size>{option.abbr...}; }, options);
+    }
+
+    // Index of an option by name (-1 if not found)
+    constexpr int indexOf(std::string_view name) const {
+        auto all = names();
+        for (size_t i = 0; i < size; i++) {
+            if (all[i] == name) {
+                return (int)i;
+            }
+        }
+        return -1;
+    }
+
+    // CHECKS
+
+    constexpr bool hasEmptyName() const {
+        auto all = names();
+        return std::any_of(all.begin(), all.end(), [](std::string_view name) { return name.empty(); });
+    }
+    constexpr bool hasDuplicateNames() const {
+        // Duplicates are next to each other once sorted
+        auto sorted = names();
+        std::sort(sorted.begin(), sorted.end());
+        for (size_t i = 1; i < size; i++) {
+            if (sorted[i - 1] == sorted[i]) {
+                return true;
+            }
+        }
+        return false;
+    }
+    constexpr bool hasDuplicateAbbrs() const {
+        auto all = abbrs();
+        for (size_t i = 0; i < size; i++) {
+            for (size_t j = i + 1; j < size; j++) {
+                if (all[i] && all[i] == all[j]) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+    constexpr bool hasInvalidRange() const {
+        return std::apply([](const auto&... option) { return (invalidRange(option) || ...); }, options);
+    }
+
+    // C INTEROPERABILITY
+
+    // The schema as a C schema (a static array built on first use)
+    template <const auto& self>
+    static const CL_Option* cSchema() {
+        static const std::array<CL_Option, size + 1> schema = std::apply([](const auto&... option) { return std::array<CL_Option, size + 1>{toC(option)..., CL_Option{.name = nullptr, .abbr = 0, .type = END, .description = nullptr, .env = nullptr, .configKey = nullptr, .constraints = nullptr}}; }, self.options);
+        return schema.data();
+    }
+
+   private:
+    template <typename Option>
+    static constexpr bool invalidRange(const Option& option) {
+        if constexpr (std::is_same_v<Option, Int> || std::is_same_v<Option, Double> || std::is_same_v<Option, IntList> ||
+                      std::is_same_v<Option, DoubleList>) {
+            return option.minValue > option.maxValue;
+        }
+        return false;
+    }
+
+    static CL_Option toC(const Boolean& option) {
+        return {.name = option.name, .abbr = option.abbr, .type = BOOLEAN, .description = option.description, .env = nullptr, .configKey = nullptr, .intOptions = {}};
+    }
+    static CL_Option toC(const Help& option) {
+        return {.name = option.name, .abbr = option.abbr, .type = HELP, .description = option.description, .env = nullptr, .configKey = nullptr, .intOptions = {}};
+    }
+    static CL_Option toC(const Int& option) {
+        return {.name = option.name,
+                .abbr = option.abbr,
+                .type = INT,
+                .description = option.description,
+                .env = nullptr,
+                .configKey = nullptr,
+                .intOptions = {option.minValue, option.maxValue, option.defaultValue}};
+    }
+    static CL_Option toC(const Double& option) {
+        return {.name = option.name,
+                .abbr = option.abbr,
+                .type = DOUBLE,
+                .description = option.description,
+                .env = nullptr,
+                .configKey = nullptr,
+                .doubleOptions = {option.minValue, option.maxValue, option.defaultValue}};
+    }
+    static CL_Option toC(const String& option) {
+        return {.name = option.name,
+                .abbr = option.abbr,
+                .type = STRING,
+                .description = option.description,
+                .env = nullptr,
+                .configKey = nullptr,
+                .strOptions = {.optional = option.optional, .oneOf = nullptr, .defaultValue = const_cast<char*>(option.defaultValue)}};
+    }
+    static CL_Option toC(const StringList& option) {
+        return {.name = option.name, .abbr = option.abbr, .type = STRING_LIST, .description = option.description, .env = nullptr, .configKey = nullptr, .intOptions = {}};
+    }
+    static CL_Option toC(const IntList& option) {
+        return {.name = option.name,
+                .abbr = option.abbr,
+                .type = INT_LIST,
+                .description = option.description,
+                .env = nullptr,
+                .configKey = nullptr,
+                .intOptions = {option.minValue, option.maxValue, 0}};
+    }
+    static CL_Option toC(const DoubleList& option) {
+        return {.name = option.name,
+                .abbr = option.abbr,
+                .type = DOUBLE_LIST,
+                .description = option.description,
+                .env = nullptr,
+                .configKey = nullptr,
+                .doubleOptions = {option.minValue, option.maxValue, 0}};
+    }
+    // The choices are those of the option, which is part of a schema with static storage
+    template <size_t N>
+    static CL_Option toC(const OneOf<N>& option) {
+        return {.name = option.name,
+                .abbr = option.abbr,
+                .type = STRING,
+                .description = option.description,
+                .env = nullptr,
+                .configKey = nullptr,
+                .strOptions = {.optional = false, .match = option.match, .oneOf = option.choices.data(), .defaultValue = nullptr}};
+    }
+};
+
+// Build a schema from options
+template <typename... Options>
+constexpr Schema<Options...> schema(Options... options) {
+    return Schema<Options...>(options...);
+}
+
+// Check a schema at compile time (every parse of a schema checks it)
+template <const auto& S>
+constexpr bool validate() {
+    static_assert(!S.hasEmptyName(), "CLargs: option with an empty name");
+    static_assert(!S.hasDuplicateNames(), "CLargs: two options have the same name");
+    static_assert(!S.hasDuplicateAbbrs(), "CLargs: two options have the same abbreviation");
+    static_assert(!S.hasInvalidRange(), "CLargs: option with a minimum greater than its maximum");
+    return true;
+}
+
+// Compiled C schema of S, built once (thread-safely) and kept for the whole program
+template <const auto& S>
+const CL_Compiled* compiled() {
+    static_assert(validate<S>());
+    static const struct Holder {
+        CL_Compiled* compiled = CL_compileSchema(std::remove_cvref_t<decltype(S)>::template cSchema<S>());
+        ~Holder() {
+            CL_freeCompiled(compiled);
+        }
+    } holder;
+    return holder.compiled;
+}
+
+// PARSE RESULT
+
+// Parsed arguments of schema S, with typed access to the options by name
+template <const auto& S>
+class Args {
+   public:
+    explicit Args(CL_Args args) : args(args) {}
+    Args(const Args&) = delete;
+    Args& operator=(const Args&) = delete;
+    Args(Args&& other) noexcept : args(std::exchange(other.args, CL_Args{})) {}
+    Args& operator=(Args&& other) noexcept {
+        std::swap(args, other.args);
+        return *this;
+    }
+    ~Args() {
+        CL_free(args);
+    }
+
+    // Value of the option at index I, with the type of the option (converted on first access
+    // if parsed lazily)
+    template <size_t I>
+    auto get() const {
+        using Option = std::tuple_element_t<I, decltype(S.options)>;
+        const CL_FlagValue value = CL_flagAt(&args, (CL_FlagId)I);
+        if constexpr (std::is_same_v<typename Option::value_type, bool>) {
+            return value.boolean;
+        } else if constexpr (std::is_same_v<typename Option::value_type, int32_t>) {
+            return value.integer;
+        } else if constexpr (std::is_same_v<typename Option::value_type, double>) {
+            return value.number;
+        } else if constexpr (std::is_same_v<Option, StringList>) {
+            return typename Option::value_type(value.list.strings, value.list.count);
+        } else if constexpr (std::is_same_v<Option, IntList>) {
+            return typename Option::value_type(value.list.integers, value.list.count);
+        } else if constexpr (std::is_same_v<Option, DoubleList>) {
+            return typename Option::value_type(value.list.numbers, value.list.count);
+        } else if constexpr (std::is_same_v<typename Option::value_type, Choice>) {
+            return Choice{value.choice.string, value.choice.index};
+        } else {
+            return (const char*)value.string;
+        }
+    }
+    // Value of an option by name (resolved at compile time)
+    template <Name N>
+    auto get() const {
+        constexpr int index = S.indexOf(N.view());
+        static_assert(index >= 0, "CLargs: no option with this name in the schema");
+        return get<(size_t)index>();
+    }
+
+    // Values not associated with options
+    std::span<char* const> values() const {
+        return {args.values, args.value_count};
+    }
+    // Program name (argv[0])
+    const char* path() const {
+        return args.path;
+    }
+    // The underlying C args
+    const CL_Args& raw() const {
+        return args;
+    }
+
+   private:
+    CL_Args args;
+};
+
+// Parse command-line arguments with schema S (using the global callbacks)
+template <const auto& S>
+Args<S> parse(int argc, char* argv[]) {
+    return Args<S>(CL_parseCompiled(argc, argv, compiled<S>()));
+}
+
+// Parse command-line arguments with schema S and a context
+template <const auto& S>
+Args<S> parse(const CL_Context& ctx, int argc, char* argv[]) {
+    return Args<S>(CL_parseContext(&ctx, argc, argv, compiled<S>()));
+}
+
+}  // namespace cl
+
+#endif
@@ -0,0 +1,410 @@
+/**
+ * bench.c
+ *
+ * Benchmarks for the CLargs parser hot paths.
+ * Every case runs in its own process (so peak RSS is per case) and prints one tab-separated line:
+ *
+ *   case  options  args  ns_per_arg  allocs_per_parse  peak_rss_kb
+ *
+ * ns_per_arg is the time per argument parsed (per flag read for the flag cases, per option for
+ * the help cases, per request for the completion case, per number for the conversion cases), and allocs_per_parse counts the allocations made through the CL_Allocator
+ * (for parse_long and the other cases parsing with CL_parseWithAllocator, this includes the schema it compiles for each parse).
+ * Lines starting with # are comments. Compare two outputs with compare.sh.
+ */
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../CLargs.h"
+
+// Number of timed repetitions of each case (the fastest one is reported)
+#define REPETITIONS 7
+// Minimum number of arguments processed per repetition
+#define MIN_ARGS_PER_REPETITION 200000
+
+// BENCHMARK DATA
+
+// Generated schema of n options, cycling through the option types (with an abbreviation for the
+// first 52 options). Option names are "opt<i>"
+static CL_Option* makeSchema(size_t n, bool booleanOnly) {
+    static const char abbrs[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
+    CL_Option* schema = calloc(n + 1, sizeof(CL_Option));
+    for (size_t i = 0; i < n; i++) {
+        char* name = malloc(24);
+        snprintf(name, 24, "opt%zu", i);
+        CL_OptionType type = booleanOnly ? BOOLEAN : (CL_OptionType[]){BOOLEAN, STRING, INT, DOUBLE}[i % 4];
+        CL_Option option = {
+            .name = name,
+            .abbr = i < sizeof(abbrs) - 1 ? abbrs[i] : 0,
+            .type = type,
+            .description = "Generated option",
+        };
+        switch (type) {
+            case INT:
+                option.intOptions.maxValue = 1000000;
+                break;
+            case DOUBLE:
+                option.doubleOptions.maxValue = 1e9;
+                break;
+            default:
+                break;
+        }
+        // Options have const members, so they are copied in
+        memcpy(&schema[i], &option, sizeof(CL_Option));
+    }
+    memcpy(&schema[n], &(CL_Option){.type = END}, sizeof(CL_Option));
+    return schema;
+}
+
+// Value for an option of the generated schema
+static char* optionValue(const CL_Option* option, size_t i) {
+    char* value = malloc(24);
+    switch (option->type) {
+        case INT:
+            snprintf(value, 24, "%zu", i % 1000000);
+            break;
+        case DOUBLE:
+            snprintf(value, 24, "%zu.%zu", i % 100000, i % 97);
+            break;
+        default:
+            snprintf(value, 24, "value%zu", i);
+    }
+    return value;
+}
+
+// Argument vector of argc arguments (including the program name)
+typedef struct {
+    int argc;
+    char** argv;
+} Argv;
+
+static Argv newArgv(size_t cap) {
+    Argv args = {.argc = 1, .argv = calloc(cap + 2, sizeof(char*))};
+    args.argv[0] = "bench";
+    return args;
+}
+
+// Long flags (with a value when the option takes one) cycling through the schema
+static Argv longFlagsArgv(const CL_Option* schema, size_t n, size_t count) {
+    Argv args = newArgv(count);
+    for (size_t i = 0; (size_t)args.argc < count; i++) {
+        const CL_Option* option = &schema[(i * 7919) % n];
+        char* flag = malloc(strlen(option->name) + 3);
+        sprintf(flag, "--%s", option->name);
+        args.argv[args.argc++] = flag;
+        if (option->type != BOOLEAN) {
+            args.argv[args.argc++] = optionValue(option, i);
+        }
+    }
+    return args;
+}
+
+// Groups of 8 boolean short flags
+static Argv groupedShortsArgv(const CL_Option* schema, size_t n, size_t count) {
+    Argv args = newArgv(count);
+    size_t abbrCount = n < 52 ? n : 52;
+    for (size_t i = 0; (size_t)args.argc < count; i++) {
+        char* group = malloc(10);
+        group[0] = '-';
+        for (size_t c = 0; c < 8; c++) {
+            group[c + 1] = schema[(i * 8 + c) % abbrCount].abbr;
+        }
+        group[9] = '\0';
+        args.argv[args.argc++] = group;
+    }
+    return args;
+}
+
+// Positional values only
+static Argv valuesArgv(size_t count) {
+    Argv args = newArgv(count);
+    while ((size_t)args.argc < count) {
+        char* value = malloc(24);
+        snprintf(value, 24, "input-%d.dat", args.argc);
+        args.argv[args.argc++] = value;
+    }
+    return args;
+}
+
+// Signed decimal integers of 1 to 10 digits, or decimal doubles (a third with an exponent)
+static Argv numbersArgv(size_t count, bool doubles) {
+    Argv args = newArgv(count);
+    for (size_t i = 0; (size_t)args.argc < count; i++) {
+        char* value = malloc(32);
+        const char* sign = i % 3 == 0 ? "-" : "";
+        uint64_t magnitude = (i * 2654435761u) % 10000000000ull;
+        for (size_t d = 0; d < i % 10; d++) {
+            magnitude /= 10;
+        }
+        if (!doubles) {
+            snprintf(value, 32, "%s%llu", sign, (unsigned long long)magnitude);
+        } else if (i % 3 == 2) {
+            snprintf(value, 32, "%s%llu.%zue-%zu", sign, (unsigned long long)magnitude, i % 1000, i % 20);
+        } else {
+            snprintf(value, 32, "%s%llu.%zu", sign, (unsigned long long)magnitude, i % 100000);
+        }
+        args.argv[args.argc++] = value;
+    }
+    return args;
+}
+
+// Long flags with values, without a schema
+static Argv schemalessArgv(size_t count) {
+    Argv args = newArgv(count);
+    for (size_t i = 0; (size_t)args.argc < count; i++) {
+        char* flag = malloc(24);
+        snprintf(flag, 24, "--flag%zu", i % 1000);
+        args.argv[args.argc++] = flag;
+        args.argv[args.argc++] = optionValue(&(CL_Option){.type = STRING}, i);
+    }
+    return args;
+}
+
+// MEASUREMENT
+
+// Default help menu (not declared in the header)
+extern bool defaultHelpCallback(const CL_Schema schema, const char* progname);
+
+static size_t allocations = 0;
+
+static void* countingAlloc(size_t size, void* userData) {
+    (void)userData;
+    allocations++;
+    return malloc(size);
+}
+static void countingFree(void* ptr, void* userData) {
+    (void)userData;
+    free(ptr);
+}
+static const CL_Allocator countingAllocator = {.alloc = countingAlloc, .free = countingFree};
+
+static void ignoreError(const char* flag, const char* msg, void* userData) {
+    (void)flag, (void)msg, (void)userData;
+}
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+typedef enum {
+    OP_PARSE,
+    OP_PARSE_COMPILED,
+    OP_PARSE_LAZY,
+    OP_FLAG,
+    OP_FLAG_AT,
+    OP_HELP,
+    OP_HELP_CACHED,
+    OP_COMPLETE,
+    OP_INT_CLARGS,
+    OP_INT_STRTOLL,
+    OP_DOUBLE_CLARGS,
+    OP_DOUBLE_STRTOD,
+} Operation;
+
+// Run an operation repeatedly, returning the best time per unit (argument, flag read, option or
+// completion request)
+static double measure(Operation operation, const CL_Option* schema, size_t n, Argv args, double* allocsPerParse) {
+    CL_Compiled* compiled = schema ? CL_compileSchema(schema) : NULL;
+    CL_Context ctx = {.onError = ignoreError, .allocator = &countingAllocator};
+    CL_Context lazyCtx = {.onError = ignoreError, .allocator = &countingAllocator, .lazy = true};
+    CL_Args parsed = CL_parseContext(&ctx, args.argc, args.argv, compiled);
+    size_t units = operation == OP_FLAG || operation == OP_FLAG_AT || operation == OP_HELP || operation == OP_HELP_CACHED ? n : (size_t)(args.argc - 1);
+    if (operation == OP_COMPLETE) {
+        units = 1;
+    }
+    size_t iterations = MIN_ARGS_PER_REPETITION / (units ? units : 1) + 1;
+    volatile uint64_t sink = 0;
+    // Completion of a long flag prefix shared by about a ninth of the options
+    char* completeArgv[] = {"bench", "__complete", "--opt1", NULL};
+
+    double best = 0;
+    for (int r = 0; r < REPETITIONS; r++) {
+        allocations = 0;
+        double start = now();
+        for (size_t it = 0; it < iterations; it++) {
+            switch (operation) {
+                case OP_PARSE:
+                    CL_free(CL_parseWithAllocator(args.argc, args.argv, schema, &countingAllocator));
+                    break;
+                case OP_PARSE_COMPILED:
+                    CL_free(CL_parseContext(&ctx, args.argc, args.argv, compiled));
+                    break;
+                case OP_PARSE_LAZY:
+                    CL_free(CL_parseContext(&lazyCtx, args.argc, args.argv, compiled));
+                    break;
+                case OP_FLAG:
+                    for (size_t i = 0; i < n; i++) {
+                        sink += CL_flag((char*)schema[i].name, parsed).integer;
+                    }
+                    break;
+                case OP_FLAG_AT:
+                    for (size_t i = 0; i < n; i++) {
+                        sink += CL_flagAt(&parsed, (CL_FlagId)i).integer;
+                    }
+                    break;
+                case OP_HELP:
+                    defaultHelpCallback(schema, "bench");
+                    break;
+                case OP_HELP_CACHED:
+                    CL_printHelp(STDOUT_FILENO, compiled, "bench");
+                    break;
+                case OP_COMPLETE:
+                    CL_complete(3, completeArgv, compiled);
+                    break;
+                // The C library converters check for trailing characters and overflow, as the
+                // converters of CLargs do
+                case OP_INT_CLARGS:
+                    for (int i = 1; i < args.argc; i++) {
+                        int64_t value;
+                        sink += CL_strToInt64(args.argv[i], &value) == CL_NUM_OK ? (uint64_t)value : 0;
+                    }
+                    break;
+                case OP_INT_STRTOLL:
+                    for (int i = 1; i < args.argc; i++) {
+                        char* end;
+                        errno = 0;
+                        long long value = strtoll(args.argv[i], &end, 10);
+                        sink += *end == '\0' && errno == 0 ? (uint64_t)value : 0;
+                    }
+                    break;
+                case OP_DOUBLE_CLARGS:
+                    for (int i = 1; i < args.argc; i++) {
+                        double value;
+                        sink += CL_strToDouble(args.argv[i], &value) == CL_NUM_OK ? (uint64_t)value : 0;
+                    }
+                    break;
+                case OP_DOUBLE_STRTOD:
+                    for (int i = 1; i < args.argc; i++) {
+                        char* end;
+                        errno = 0;
+                        double value = strtod(args.argv[i], &end);
+                        sink += *end == '\0' && errno == 0 ? (uint64_t)value : 0;
+                    }
+                    break;
+            }
+        }
+        double elapsed = (now() - start) / iterations / (units ? units : 1);
+        if (r == 0 || elapsed < best) {
+            best = elapsed;
+        }
+        *allocsPerParse = operation == OP_PARSE || operation == OP_PARSE_COMPILED || operation == OP_PARSE_LAZY ? (double)allocations / iterations : 0;
+    }
+
+    CL_free(parsed);
+    if (compiled) {
+        CL_freeCompiled(compiled);
+    }
+    return best;
+}
+
+// Run a case in a child process and print its result line
+static void runCase(const char* name, Operation operation, size_t options, const char* shape, size_t argCount) {
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        exit(EXIT_FAILURE);
+    }
+    if (pid > 0) {
+        waitpid(pid, NULL, 0);
+        return;
+    }
+
+    CL_Option* schema = options ? makeSchema(options, strcmp(shape, "grouped") == 0) : NULL;
+    Argv args;
+    if (strcmp(shape, "long") == 0) {
+        args = longFlagsArgv(schema, options, argCount);
+    } else if (strcmp(shape, "grouped") == 0) {
+        args = groupedShortsArgv(schema, options, argCount);
+    } else if (strcmp(shape, "values") == 0) {
+        args = valuesArgv(argCount);
+    } else if (strcmp(shape, "integers") == 0 || strcmp(shape, "doubles") == 0) {
+        args = numbersArgv(argCount, strcmp(shape, "doubles") == 0);
+    } else {
+        args = schemalessArgv(argCount);
+    }
+
+    // Help and completion output is written to /dev/null
+    int savedStdout = dup(STDOUT_FILENO);
+    if (operation == OP_HELP || operation == OP_HELP_CACHED || operation == OP_COMPLETE) {
+        fflush(stdout);
+        freopen("/dev/null", "w", stdout);
+    }
+    double allocsPerParse;
+    double ns = measure(operation, schema, options, args, &allocsPerParse);
+    if (operation == OP_HELP || operation == OP_HELP_CACHED || operation == OP_COMPLETE) {
+        fflush(stdout);
+        dup2(savedStdout, STDOUT_FILENO);
+    }
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    printf("%s\t%zu\t%d\t%.2f\t%.2f\t%ld\n", name, options, args.argc - 1, ns, allocsPerParse, usage.ru_maxrss);
+    fflush(stdout);
+    _exit(EXIT_SUCCESS);
+}
+
+int main(int argc, char* argv[]) {
+    // Optional case name filter
+    const char* filter = argc > 1 ? argv[1] : NULL;
+    static const size_t sizes[] = {10, 100, 1000};
+
+    printf("# clargs-bench 2\n");
+    printf("# case\toptions\targs\tns_per_arg\tallocs_per_parse\tpeak_rss_kb\n");
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(*sizes); s++) {
+        size_t n = sizes[s];
+        char name[64];
+        struct {
+            const char* name;
+            Operation operation;
+            const char* shape;
+            size_t args;
+        } cases[] = {
+            {"parse_long", OP_PARSE, "long", 10000},
+            {"parse_compiled_long", OP_PARSE_COMPILED, "long", 10000},
+            {"parse_lazy_long", OP_PARSE_LAZY, "long", 10000},
+            {"parse_grouped", OP_PARSE, "grouped", 10000},
+            {"flag", OP_FLAG, "long", 1000},
+            {"flag_at", OP_FLAG_AT, "long", 1000},
+            {"help", OP_HELP, "long", 1},
+            {"help_cached", OP_HELP_CACHED, "long", 1},
+            {"complete", OP_COMPLETE, "long", 1},
+        };
+        for (size_t c = 0; c < sizeof(cases) / sizeof(*cases); c++) {
+            snprintf(name, sizeof(name), "%s/%zu", cases[c].name, n);
+            if (!filter || strstr(name, filter)) {
+                runCase(name, cases[c].operation, n, cases[c].shape, cases[c].args);
+            }
+        }
+    }
+    if (!filter || strstr("parse_values", filter)) {
+        runCase("parse_values", OP_PARSE, 10, "values", 100000);
+    }
+    if (!filter || strstr("parse_schemaless", filter)) {
+        runCase("parse_schemaless", OP_PARSE, 0, "schemaless", 10000);
+    }
+    // Number conversions, against the C library on the same inputs
+    static const struct {
+        const char* name;
+        Operation operation;
+        const char* shape;
+    } conversions[] = {
+        {"convert_int", OP_INT_CLARGS, "integers"},
+        {"convert_int_strtoll", OP_INT_STRTOLL, "integers"},
+        {"convert_double", OP_DOUBLE_CLARGS, "doubles"},
+        {"convert_double_strtod", OP_DOUBLE_STRTOD, "doubles"},
+    };
+    for (size_t c = 0; c < sizeof(conversions) / sizeof(*conversions); c++) {
+        if (!filter || strstr(conversions[c].name, filter)) {
+            runCase(conversions[c].name, conversions[c].operation, 0, conversions[c].shape, 10000);
+        }
+    }
+    return 0;
+}
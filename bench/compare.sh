@@ -0,0 +1,24 @@
+#!/bin/sh
+# Compare two outputs of the benchmark, printing the change of each case and failing if any
+# case got slower (ns_per_arg) or used more allocations than the baseline allows.
+#
+# Usage: compare.sh baseline.tsv current.tsv [max_slowdown_percent (default 10)]
+
+if [ $# -lt 2 ]; then
+    echo "Usage: $0 baseline.tsv current.tsv [max_slowdown_percent]" >&2
+    exit 2
+fi
+
+awk -F '\t' -v threshold="${3:-10}" '
+    /^#/ { next }
+    FNR == NR { ns[$1] = $4; allocs[$1] = $5; next }
+    !($1 in ns) { printf "%-28s %10s -> %10.2f ns  (new)\n", $1, "", $4; next }
+    {
+        change = ns[$1] > 0 ? ($4 - ns[$1]) * 100 / ns[$1] : 0
+        status = ""
+        if (change > threshold) { status = "  SLOWER"; failed = 1 }
+        if ($5 > allocs[$1]) { status = status "  MORE ALLOCATIONS"; failed = 1 }
+        printf "%-28s %10.2f -> %10.2f ns  (%+.1f%%)%s\n", $1, ns[$1], $4, change, status
+    }
+    END { exit failed }
+' "$1" "$2"
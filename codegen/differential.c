@@ -0,0 +1,180 @@
+/**
+ * differential.c
+ *
+ * Differential check of the generated parser: parses random argument vectors built from the
+ * schema with both CL_parseContext and the generated parser, and compares the results.
+ * Usage: differential [iterations] [seed]
+ * Exits with an error (after printing the arguments) at the first difference.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "schema.h"
+// Generated by generate (with the default prefix)
+#include "parser.c"
+
+// Longest argument vector tried
+#define MAX_ARGS 12
+
+static const char* const values[] = {
+    "", "-", "--", "0", "1", "7", "10", "11", "-3", "0x1f", "0b101", "0o17", "2147483648", "99999999999999999999", "1.5", "-1.5", "-2",
+    "1e3", "1e999", "nan", "abc", "add", "sub", "div", "mo", "65535", "65536", "@", "out.txt", "ADD", "j", "json",
+    "JSONL", "tsv", "t", "te", "xml",
+};
+
+// Random argument (allocated in buffer) built from the schema
+static char* randomArg(char* buffer, size_t size) {
+    size_t option_count = 0;
+    while (schema[option_count].type != END) {
+        option_count++;
+    }
+    const CL_Option* option = &schema[rand() % option_count];
+    const char* value = values[rand() % (sizeof(values) / sizeof(*values))];
+    switch (rand() % 9) {
+        case 0:
+            snprintf(buffer, size, "--%s", option->name);
+            break;
+        case 1:  // Prefix of a name
+            snprintf(buffer, size, "--%.*s", (int)(rand() % (strlen(option->name) + 1)), option->name);
+            break;
+        case 2:
+            snprintf(buffer, size, "--%s=%s", option->name, value);
+            break;
+        case 3:
+            snprintf(buffer, size, "-%c", option->abbr ? option->abbr : 'z');
+            break;
+        case 4: {  // Group of short flags
+            size_t length = 1;
+            buffer[0] = '-';
+            for (int i = rand() % 4 + 2; i > 0; i--) {
+                const CL_Option* grouped = &schema[rand() % option_count];
+                buffer[length++] = grouped->abbr ? grouped->abbr : 'q';
+            }
+            buffer[length] = '\0';
+            break;
+        }
+        case 5:
+            snprintf(buffer, size, "--unknown%s", rand() % 2 ? "=1" : "");
+            break;
+        default:
+            snprintf(buffer, size, "%s", value);
+            break;
+    }
+    return buffer;
+}
+
+static bool sameString(const char* a, const char* b) {
+    return a == b || (a && b && strcmp(a, b) == 0);
+}
+
+static bool sameNumber(double a, double b) {
+    return a == b || (a != a && b != b);
+}
+
+// Compare the results of both parsers, printing the first difference
+static bool compare(const CL_Args* expected, const app_Args* actual) {
+    if (expected->help_requested != actual->help_requested || expected->error_count != actual->error_count) {
+        printf("help %d/%d, errors %u/%u\n", expected->help_requested, actual->help_requested, expected->error_count, actual->error_count);
+        return false;
+    }
+    if (expected->error_count) {
+        const CL_Error* a = &expected->errors[0];
+        const CL_Error* b = &actual->first_error;
+        if (a->code != b->code || a->argIndex != b->argIndex || a->offset != b->offset || a->id != b->id || a->related != b->related) {
+            printf("first error %d at %d+%d (option %d, %d) / %d at %d+%d (option %d, %d)\n", a->code, a->argIndex, a->offset, a->id, a->related, b->code,
+                   b->argIndex, b->offset, b->id, b->related);
+            return false;
+        }
+    }
+    if (expected->value_count != actual->value_count) {
+        printf("values %zu/%u\n", (size_t)expected->value_count, actual->value_count);
+        return false;
+    }
+    for (size_t v = 0; v < expected->value_count; v++) {
+        if (expected->values[v] != actual->values[v]) {
+            printf("value %zu: %s/%s\n", v, expected->values[v], actual->values[v]);
+            return false;
+        }
+    }
+    for (CL_FlagId i = 0; schema[i].type != END; i++) {
+        CL_FlagValue a = CL_flagAt(expected, i);
+        CL_FlagValue b = app_value(actual, i);
+        bool same = true;
+        switch (schema[i].type) {
+            case HELP:
+            case BOOLEAN:
+                same = a.boolean == b.boolean;
+                break;
+            case STRING:
+                same = sameString(a.string, b.string) && (!schema[i].strOptions.oneOf || a.choice.index == b.choice.index);
+                break;
+            case INT:
+                same = a.integer == b.integer;
+                break;
+            case DOUBLE:
+                same = sameNumber(a.number, b.number);
+                break;
+            case STRING_LIST:
+            case INT_LIST:
+            case DOUBLE_LIST:
+                same = a.list.count == b.list.count;
+                for (uint32_t item = 0; same && item < a.list.count; item++) {
+                    same = schema[i].type == STRING_LIST ? a.list.strings[item] == b.list.strings[item]
+                           : schema[i].type == INT_LIST  ? a.list.integers[item] == b.list.integers[item]
+                                                         : sameNumber(a.list.numbers[item], b.list.numbers[item]);
+                }
+                break;
+            case END:
+            case SUBCOMMAND:
+                break;
+        }
+        if (!same) {
+            printf("option --%s differs\n", schema[i].name);
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    long iterations = argc > 1 ? atol(argv[1]) : 100000;
+    srand(argc > 2 ? (unsigned)atol(argv[2]) : 1);
+    CL_Compiled* compiled = CL_compileSchema(schema);
+    CL_Context ctx = {.collectErrors = true};
+    char buffers[MAX_ARGS][64];
+    char* args[MAX_ARGS + 1];
+    long compared = 0;
+
+    for (long it = 0; it < iterations; it++) {
+        int count = rand() % MAX_ARGS + 1;
+        args[0] = "app";
+        for (int a = 1; a < count; a++) {
+            args[a] = randomArg(buffers[a], sizeof(buffers[a]));
+        }
+        args[count] = NULL;
+
+        app_Args actual;
+        if (!app_parse(count, args, &actual)) {
+            // Response files are left to CL_parse
+            continue;
+        }
+        CL_Args expected = CL_parseContext(&ctx, count, args, compiled);
+        bool same = compare(&expected, &actual);
+        CL_free(expected);
+        app_free(&actual);
+        if (!same) {
+            printf("arguments:");
+            for (int a = 1; a < count; a++) {
+                printf(" '%s'", args[a]);
+            }
+            printf("\n");
+            return EXIT_FAILURE;
+        }
+        compared++;
+    }
+    CL_freeCompiled(compiled);
+    printf("%ld argument vectors parsed identically\n", compared);
+    return EXIT_SUCCESS;
+}
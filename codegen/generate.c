@@ -0,0 +1,22 @@
+/**
+ * generate.c
+ *
+ * Print the source of the parser specialized for the schema of schema.h.
+ * Usage: generate [prefix] > parser.c
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "schema.h"
+
+int main(int argc, char* argv[]) {
+    char* source = CL_generateParser(schema, argc > 1 ? argv[1] : "app");
+    if (!source) {
+        fprintf(stderr, "generate: schemas with subcommands are not supported\n");
+        return EXIT_FAILURE;
+    }
+    fputs(source, stdout);
+    free(source);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,36 @@
+/**
+ * schema.h
+ *
+ * Schema of the generated parser, shared by the generator and the differential checker.
+ * Replace it with the schema of your program.
+ */
+
+#ifndef CODEGEN_SCHEMA_H
+#define CODEGEN_SCHEMA_H
+
+#include <math.h>
+
+#include "../CLargs.h"
+
+static const CL_Schema schema = CL_DEFINESCHEMA(
+    OPTION_BOOLEAN("verbose", 'v', "Enable verbose output"),
+    OPTION_BOOLEAN("version", 'V', "Print the version"),
+    OPTION_BOOLEAN("dry-run", 'n', "Only print what would be done"),
+    OPTION_ONEOF("mode", 'm', "Operation to perform", "add", "sub", "mul", "div"),
+    OPTION_ONEOF_MATCH("format", 'f', "Output format", CL_MATCH_NOCASE | CL_MATCH_PREFIX, "text", "json", "jsonl", "TSV"),
+    OPTION_INT("power", 'p', "Power to raise the result to", 0, 10, 1),
+    OPTION_INT("offset", 0, "Offset added to the result", 0, 0, 0),
+    OPTION_DOUBLE("scale", 's', "Scale of the result", -1.5, 1e3, NAN),
+    OPTION_STRING("output", 'o', "Output file", "out.txt"),
+    OPTION_OPTIONAL("color", 0, "Color the output", NULL),
+    OPTION_STRING_LIST("include", 'I', "Directory to search"),
+    OPTION_INT_LIST("port", 'P', "Port to listen on", 1, 65535),
+    OPTION_DOUBLE_LIST("weight", 0, "Weight of an input", 0, 0),
+    OPTION_HELP(),
+    OPTION_CONSTRAINTS(
+        CL_REQUIRES("scale", "power", "format=TSV"),
+        CL_CONFLICTS("dry-run", "output", "mode=div"),
+        CL_EXACTLY_ONE_OF("verbose", "version", "mode=add"),
+        CL_AT_LEAST_ONE_OF("include", "port", "format=json")));
+
+#endif
@@ -7,18 +7,22 @@
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <string.h>
 
 #include "../CLargs.h"
 
 const CL_Schema schema = CL_DEFINESCHEMA(
     OPTION_BOOLEAN("verbose", 'v', "enable verbose output"),
     OPTION_BOOLEAN("round", 'r', "round final value before output"),
-    OPTION_ONEOF("mode", 0, "Operation to perform", "add", "sub", "mul", "div"),  // 0 (or '\0') for no shorthand abbreviation
+    OPTION_ONEOF_MATCH("mode", 0, "Operation to perform", CL_MATCH_PREFIX, "add", "sub", "mul", "div"),  // 0 (or '\0') for no shorthand abbreviation
     OPTION_DOUBLE("xValue", 'x', "First value of operation", 0, 0, NAN),
     OPTION_DOUBLE("yValue", 'y', "Second value of operation", 0, 0, NAN),
     OPTION_INT("power", 'p', "Power to raise the final result to before output", 0, 10, 1),
-    OPTION_HELP());
+    OPTION_HELP(),
+    // Checked after parsing, like any other argument error
+    OPTION_CONSTRAINTS(
+        CL_REQUIRES("xValue", "yValue"),
+        CL_REQUIRES("yValue", "xValue"),
+        CL_CONFLICTS("round", "mode=div")));
 
 // You can incorporate the default help menu into your custom callback by declaring it like so!
 extern bool defaultHelpCallback(const CL_Schema schema, const char* progname);
@@ -31,6 +35,7 @@ bool customHelpCallback(const CL_Schema schema, const char* progname) {
     return true;
 }
 
+// Same order as the choices of the mode option, so a choice index is a Mode
 typedef enum {
     ADD,
     SUB,
@@ -38,52 +43,23 @@ typedef enum {
     DIV,
 } Mode;
 
-Mode getMode(char* mode_string) {
-    if (strcmp(mode_string, "sub") == 0) {
-        return SUB;
-    }
-    if (strcmp(mode_string, "mul") == 0) {
-        return MUL;
-    }
-    if (strcmp(mode_string, "div") == 0) {
-        return DIV;
-    }
-    // either "add" or "", either way want add
-    return ADD;
-}
-
 int main(int argc, char* argv[]) {
     CL_setHelpCallback(customHelpCallback);
     CL_Args args = CL_parse(argc, argv, schema);
 
     double x = CL_flag("xValue", args).number;
     double y = CL_flag("yValue", args).number;
-    // Set the values of x and y to the values if the args were not provided
-    if (isnan(x) && isnan(y)) {
+    // The x and y flags require each other, without them x and y are the first two values
+    if (!CL_isSet(&args, CL_flagId(schema, "xValue"))) {
         if (args.value_count < 2) {
             fprintf(stderr, "Expected a value for x and y\n");
             exit(EXIT_FAILURE);
-        } else {
-            x = strtod(args.values[0], NULL);
-            y = strtod(args.values[1], NULL);
-        }
-    } else if (isnan(x)) {
-        if (args.value_count < 1) {
-            fprintf(stderr, "Expected a value for x\n");
-            exit(EXIT_FAILURE);
-        } else {
-            x = strtod(args.values[0], NULL);
-        }
-    } else if (isnan(y)) {
-        if (args.value_count < 1) {
-            fprintf(stderr, "Expected a value for y\n");
-            exit(EXIT_FAILURE);
-        } else {
-            y = strtod(args.values[0], NULL);
         }
+        x = strtod(args.values[0], NULL);
+        y = strtod(args.values[1], NULL);
     }
 
-    Mode mode = getMode(CL_flag("mode", args).string);
+    Mode mode = (Mode)CL_flag("mode", args).choice.index;
     int32_t power = CL_flag("power", args).integer;
     bool roundResult = CL_flag("round", args).boolean;
     bool verbose = CL_flag("verbose", args).boolean;
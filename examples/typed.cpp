@@ -0,0 +1,37 @@
+/**
+ * typed.cpp
+ *
+ * Example program for CLargs (C++ compile-time schema with typed access)
+ * Try calling the program with different options, or changing the schema to be invalid
+ * (eg giving two options the same abbreviation) to see it rejected at compile time!
+ */
+#include <cmath>
+#include <cstdio>
+
+#include "../CLargs.hpp"
+
+static constexpr auto schema = cl::schema(
+    cl::boolean("verbose", 'v', "enable verbose output"),
+    cl::oneOf("mode", 0, "Operation to perform", "add", "mul"),
+    cl::number("xValue", 'x', "First value of operation", 0, 0, 1),
+    cl::number("yValue", 'y', "Second value of operation", 0, 0, 1),
+    cl::integer("power", 'p', "Power to raise the final result to before output", 0, 10, 1),
+    cl::help());
+
+int main(int argc, char* argv[]) {
+    auto args = cl::parse<schema>(argc, argv);
+
+    // Each option has the type of its definition, and unknown names don't compile
+    double x = args.get<"xValue">();
+    double y = args.get<"yValue">();
+    int32_t power = args.get<"power">();
+    bool multiply = args.get<"mode">().index == 1;
+
+    if (args.get<"verbose">()) {
+        std::printf("Computing (%f %c %f) ^ %d\n", x, multiply ? '*' : '+', y, power);
+    }
+    std::printf("%f\n", std::pow(multiply ? x * y : x + y, power));
+    // The C schema of a compile-time schema can still be used with the C API
+    const CL_Option* cSchema = decltype(schema)::cSchema<schema>();
+    std::printf("(%d values, first option: --%s)\n", (int)args.values().size(), cSchema[0].name);
+}
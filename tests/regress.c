@@ -0,0 +1,403 @@
+/**
+ * regress.c
+ *
+ * Regression checks for parser bugs (exits with failure on the first broken check).
+ * Usage: regress
+ */
+
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <locale.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "../CLargs.h"
+
+#define CHECK(condition)                                                                  \
+    do {                                                                                  \
+        if (!(condition)) {                                                               \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            exit(EXIT_FAILURE);                                                           \
+        }                                                                                 \
+    } while (0)
+
+static const CL_Schema run = CL_DEFINESCHEMA(OPTION_INT("count", 'n', "Number of runs", 0, 10, 1));
+static const CL_Schema commands = CL_DEFINESCHEMA(OPTION_BOOLEAN("verbose", 'v', "Enable verbose output"), OPTION_SUBCOMMAND("run", "Run it", run));
+
+// Collected errors of a subcommand are in the errors of its parent, also with errors after them
+static void subcommandErrors(void) {
+    CL_Compiled* compiled = CL_compileSchema(commands);
+    CL_Context ctx = {.collectErrors = true};
+    char* argv[] = {"p", "--bad", "run", "-n", "x", NULL};
+
+    CL_Args args = CL_parseContext(&ctx, 5, argv, compiled);
+    CHECK(args.error_count == 2 && args.errors);
+    CHECK(args.errors[0].code == CL_ERR_UNKNOWN_OPTION && args.errors[1].code == CL_ERR_INVALID_NUMBER);
+    CHECK(args.subcommand && args.subcommand->error_count == 1);
+    CL_free(args);
+
+    // The unreadable config file is reported after the subcommand's errors
+    args = CL_parseLayered(&ctx, 4, argv + 1, compiled, "/nonexistent/config");
+    CHECK(args.error_count == 2 && args.errors);
+    CHECK(args.errors[0].code == CL_ERR_INVALID_NUMBER && args.errors[1].code == CL_ERR_CONFIG_UNREADABLE);
+    CL_free(args);
+
+    CL_Argv line = {.argc = 5, .argv = argv};
+    CL_Result result;
+    CL_parseBatch(compiled, &line, 1, &result, 1);
+    CHECK(!result.ok && result.args.error_count == 2 && result.args.errors[1].code == CL_ERR_INVALID_NUMBER);
+    CL_freeBatch(&result, 1);
+    CL_freeCompiled(compiled);
+}
+
+static const CL_Schema constrained = CL_DEFINESCHEMA(
+    OPTION_BOOLEAN("a", 'a', "First of the group"),
+    OPTION_BOOLEAN("b", 'b', "Second of the group"),
+    OPTION_SUBCOMMAND("run", "Run it", run),
+    OPTION_CONSTRAINTS(CL_AT_LEAST_ONE_OF("a", "b")));
+
+static int handled;
+static void countError(const char* flag, const char* msg, void* userData) {
+    (void)flag;
+    (void)msg;
+    (void)userData;
+    handled++;
+}
+
+// Constraints of the parent are checked after the collected errors of a subcommand
+static void constraintsAfterSubcommand(void) {
+    CL_Compiled* compiled = CL_compileSchema(constrained);
+    char* argv[] = {"p", "run", "-n", "x", NULL};
+    CL_Context contexts[] = {{.collectErrors = true}, {.collectErrors = true, .onError = countError}};
+    for (size_t c = 0; c < sizeof(contexts) / sizeof(contexts[0]); c++) {
+        CL_Args args = CL_parseContext(&contexts[c], 4, argv, compiled);
+        CHECK(args.error_count == 2 && args.errors);
+        CHECK(args.errors[0].code == CL_ERR_INVALID_NUMBER && args.errors[1].code == CL_ERR_MISSING_ONE_OF);
+        CHECK(args.errors[1].id == 0 && args.errors[1].related == CL_NO_FLAG);
+        CL_free(args);
+    }
+    CHECK(handled == 2);
+    CL_freeCompiled(compiled);
+}
+
+static size_t allocations, releases;
+static void* countingAlloc(size_t size, void* userData) {
+    (void)userData;
+    allocations++;
+    return malloc(size);
+}
+static void countingFree(void* ptr, void* userData) {
+    (void)userData;
+    releases++;
+    free(ptr);
+}
+
+// The temporary compiled schemas of CL_parseWithAllocator (of the parent and of the selected
+// subcommand) come from its allocator, and are released to it
+static void allocatorCompiles(void) {
+    CL_Allocator counting = {.alloc = countingAlloc, .free = countingFree};
+    char* argv[] = {"p", "run", "-n", "3", NULL};
+
+    CL_Compiled* compiled = CL_compileSchema(commands);
+    CL_Context ctx = {.allocator = &counting};
+    CL_Args args = CL_parseContext(&ctx, 4, argv, compiled);
+    CL_free(args);
+    CL_freeCompiled(compiled);
+    size_t precompiled = allocations;
+    CHECK(precompiled > 0 && releases == precompiled);
+
+    allocations = releases = 0;
+    args = CL_parseWithAllocator(4, argv, commands, &counting);
+    CHECK(args.subcommand && CL_flagAt(args.subcommand, 0).integer == 3);
+    CHECK(allocations == precompiled + 2 && releases == 2);
+    CL_free(args);
+    CHECK(releases == allocations);
+}
+
+// The program run for the completion of a subcommand's arguments is quoted in zsh scripts
+static void zshProgname(void) {
+    char* script = CL_completionScript(commands, "my prog's", CL_SHELL_ZSH);
+    CHECK(strstr(script, "$('my prog'\\''s' __complete "));
+    free(script);
+}
+
+// The program name is quoted where bash and fish scripts run or register it, and kept on the
+// comment lines of the scripts
+static void shellProgname(void) {
+    char* script = CL_completionScript(commands, "my prog's\n$x", CL_SHELL_BASH);
+    CHECK(strstr(script, "# bash completion for my prog's $x (generated"));
+    CHECK(strstr(script, "complete -o default -F _my_prog_s__x_complete \"my prog's\n\\$x\"\n"));
+    free(script);
+
+    script = CL_completionScript(commands, "my prog's", CL_SHELL_FISH);
+    CHECK(strstr(script, "complete -c 'my prog\\'s' -n 'not"));
+    CHECK(strstr(script, "-a '(\\'my prog\\\\\\'s\\' __complete "));
+    free(script);
+
+    script = CL_completionScript(commands, "my prog's\n", CL_SHELL_ZSH);
+    const char* header = "#compdef my_prog's_\n# zsh completion for my prog's  (generated";
+    CHECK(strncmp(script, header, strlen(header)) == 0);
+    free(script);
+}
+
+// The usage line printed with a compiled help menu is the one rendered by CL_renderHelp
+static void printedUsage(void) {
+    CL_Compiled* compiled = CL_compileSchema(commands);
+    char* rendered = CL_renderHelp(commands, "prog", CL_HELP_TEXT, 0, NULL);
+    int fd = memfd_create("help", 0);
+    CHECK(fd >= 0 && CL_printHelp(fd, compiled, "prog"));
+    char printed[4096] = {0};
+    CHECK(pread(fd, printed, sizeof(printed) - 1, 0) > 0);
+    CHECK(strncmp(printed, rendered, strchr(rendered, '\n') - rendered + 1) == 0);
+    close(fd);
+    free(rendered);
+    CL_freeCompiled(compiled);
+}
+
+static void ignoreSignal(int signal) {
+    (void)signal;
+}
+
+// Pipe that the main thread blocks writing to, interrupted by a signal before it is drained
+typedef struct {
+    int fds[2];
+    pthread_t writer;
+    char drained[1 << 20];
+    size_t length;
+} Interrupted;
+
+static void* interruptThenDrain(void* arg) {
+    Interrupted* state = arg;
+    usleep(50000);
+    pthread_kill(state->writer, SIGUSR1);
+    usleep(50000);
+    ssize_t count;
+    while ((count = read(state->fds[0], state->drained + state->length, sizeof(state->drained) - state->length)) > 0) {
+        state->length += count;
+    }
+    return NULL;
+}
+
+// The help menu is written whole when a signal without SA_RESTART interrupts the write
+static void interruptedHelp(void) {
+    static Interrupted interrupted;
+    CL_Compiled* compiled = CL_compileSchema(commands);
+    const char* help = CL_compiledHelp(compiled);
+    struct sigaction action = {.sa_handler = ignoreSignal};
+    struct sigaction previous;
+    CHECK(sigaction(SIGUSR1, &action, &previous) == 0);
+    CHECK(pipe(interrupted.fds) == 0);
+
+    // Fill the pipe, so that the next write blocks
+    fcntl(interrupted.fds[1], F_SETFL, O_NONBLOCK);
+    char filler[4096];
+    memset(filler, 'x', sizeof(filler));
+    ssize_t count;
+    size_t filled = 0;
+    while ((count = write(interrupted.fds[1], filler, sizeof(filler))) > 0) {
+        filled += count;
+    }
+    fcntl(interrupted.fds[1], F_SETFL, 0);
+
+    interrupted.writer = pthread_self();
+    pthread_t drainer;
+    CHECK(pthread_create(&drainer, NULL, interruptThenDrain, &interrupted) == 0);
+    CHECK(CL_printHelp(interrupted.fds[1], compiled, NULL));
+    close(interrupted.fds[1]);
+    pthread_join(drainer, NULL);
+    CHECK(interrupted.length == filled + strlen(help) && memcmp(interrupted.drained + filled, help, strlen(help)) == 0);
+
+    close(interrupted.fds[0]);
+    sigaction(SIGUSR1, &previous, NULL);
+    CL_freeCompiled(compiled);
+}
+
+// Integer conversions at the limits of int64_t, with bases, separators and syntax errors
+static void integerConversions(void) {
+    static const struct {
+        const char* str;
+        CL_NumResult result;
+        int64_t value;
+    } cases[] = {
+        {"9223372036854775807", CL_NUM_OK, INT64_MAX},
+        {"9223372036854775808", CL_NUM_OVERFLOW, 0},
+        {"-9223372036854775808", CL_NUM_OK, INT64_MIN},
+        {"-9223372036854775809", CL_NUM_OVERFLOW, 0},
+        {"0x7fffffffffffffff", CL_NUM_OK, INT64_MAX},
+        {"-0x8000000000000000", CL_NUM_OK, INT64_MIN},
+        {"0x8000000000000000", CL_NUM_OVERFLOW, 0},
+        {"-0b1010", CL_NUM_OK, -10},
+        {"0o17", CL_NUM_OK, 15},
+        {"+42", CL_NUM_OK, 42},
+        {"1_000_000", CL_NUM_OK, 1000000},
+        {"0xff_ff", CL_NUM_OK, 0xffff},
+        {"_1", CL_NUM_SYNTAX, 0},
+        {"1_", CL_NUM_SYNTAX, 0},
+        {"1__0", CL_NUM_SYNTAX, 0},
+        {"-_1", CL_NUM_SYNTAX, 0},
+        {"", CL_NUM_EMPTY, 0},
+        {"-", CL_NUM_EMPTY, 0},
+        {"0x", CL_NUM_EMPTY, 0},
+        {"0b102", CL_NUM_SYNTAX, 0},
+        {" 1", CL_NUM_SYNTAX, 0},
+        {"1 ", CL_NUM_SYNTAX, 0},
+        {"1.0", CL_NUM_SYNTAX, 0},
+    };
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+        int64_t value = 0;
+        CL_NumResult result = CL_strToInt64(cases[c].str, &value);
+        if (result != cases[c].result || (result == CL_NUM_OK && value != cases[c].value)) {
+            fprintf(stderr, "CL_strToInt64(\"%s\") = %d, %lld\n", cases[c].str, result, (long long)value);
+        }
+        CHECK(result == cases[c].result && (result != CL_NUM_OK || value == cases[c].value));
+    }
+}
+
+// Double conversions of the fast path and the fallback, with separators and syntax errors
+static void doubleConversions(void) {
+    static const struct {
+        const char* str;
+        CL_NumResult result;
+        double value;
+    } cases[] = {
+        {"0.1", CL_NUM_OK, 0.1},
+        {"-2.5e3", CL_NUM_OK, -2500},
+        {".5", CL_NUM_OK, 0.5},
+        {"1_000.000_5", CL_NUM_OK, 1000.0005},
+        {"1e23", CL_NUM_OK, 1e23},
+        {"4.9e-324", CL_NUM_OK, 4.9e-324},
+        {"1.7976931348623157e308", CL_NUM_OK, 1.7976931348623157e308},
+        {"1e309", CL_NUM_OVERFLOW, 0},
+        {"-1e309", CL_NUM_OVERFLOW, 0},
+        // More significant digits than the mantissa holds (converted by the fallback)
+        {"12345678901234567890123", CL_NUM_OK, 12345678901234567890123.0},
+        {"0.1234567890123456789012345", CL_NUM_OK, 0.1234567890123456789012345},
+        {"9_007_199_254_740_993.000_000_000_1", CL_NUM_OK, 9007199254740993.0000000001},
+        {"_1", CL_NUM_SYNTAX, 0},
+        {"1_", CL_NUM_SYNTAX, 0},
+        {"1__0", CL_NUM_SYNTAX, 0},
+        {"1._5", CL_NUM_SYNTAX, 0},
+        {"", CL_NUM_EMPTY, 0},
+        {"-", CL_NUM_EMPTY, 0},
+        {"1e", CL_NUM_SYNTAX, 0},
+        {"1e+", CL_NUM_SYNTAX, 0},
+        {"inf", CL_NUM_SYNTAX, 0},
+        {"nan", CL_NUM_SYNTAX, 0},
+        {"0x10", CL_NUM_SYNTAX, 0},
+        {"1,5", CL_NUM_SYNTAX, 0},
+    };
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+        double value = 0;
+        CL_NumResult result = CL_strToDouble(cases[c].str, &value);
+        if (result != cases[c].result || (result == CL_NUM_OK && value != cases[c].value)) {
+            fprintf(stderr, "CL_strToDouble(\"%s\") = %d, %.17g\n", cases[c].str, result, value);
+        }
+        CHECK(result == cases[c].result && (result != CL_NUM_OK || value == cases[c].value));
+    }
+
+    // Numbers longer than any fixed buffer, with and without separators
+    char number[1300];
+    memset(number, '1', 600);
+    strcpy(number + 600, "e-500");
+    double value;
+    CHECK(CL_strToDouble(number, &value) == CL_NUM_OK && value > 1.1e99 && value < 1.2e99);
+    for (int i = 0; i < 600; i++) {
+        number[2 * i] = '1';
+        number[2 * i + 1] = '_';
+    }
+    strcpy(number + 1199, "e-500");
+    CHECK(CL_strToDouble(number, &value) == CL_NUM_OK && value > 1.1e99 && value < 1.2e99);
+    memset(number, '1', 600);
+    number[600] = '\0';
+    CHECK(CL_strToDouble(number, &value) == CL_NUM_OVERFLOW);
+}
+
+// The decimal point is "." whatever the locale (skipped if no locale with another one exists)
+static void doublesInLocale(void) {
+    static const char* const locales[] = {"de_DE.UTF-8", "fr_FR.UTF-8", "it_IT.UTF-8", "ru_RU.UTF-8", "ps_AF.UTF-8"};
+    const char* found = NULL;
+    for (size_t l = 0; !found && l < sizeof(locales) / sizeof(locales[0]); l++) {
+        if (setlocale(LC_NUMERIC, locales[l]) && strcmp(localeconv()->decimal_point, ".") != 0) {
+            found = locales[l];
+        }
+    }
+    if (!found) {
+        setlocale(LC_NUMERIC, "C");
+        fprintf(stderr, "doublesInLocale: skipped, no locale with another decimal point\n");
+        return;
+    }
+    double value;
+    CHECK(CL_strToDouble("1.5", &value) == CL_NUM_OK && value == 1.5);
+    CHECK(CL_strToDouble("0.1234567890123456789012345", &value) == CL_NUM_OK && value == 0.1234567890123456789012345);
+    CHECK(CL_strToDouble("1_234.567_890_123_456_789_012", &value) == CL_NUM_OK && value == 1234.567890123456789012);
+    CHECK(CL_strToDouble("1,5", &value) == CL_NUM_SYNTAX);
+    setlocale(LC_NUMERIC, "C");
+}
+
+static const CL_Schema listed = CL_DEFINESCHEMA(
+    OPTION_STRING("name", 'n', "Name", "none"),
+    OPTION_STRING_LIST("include", 'I', "Directory to search"),
+    OPTION_INT_LIST("port", 'P', "Port to listen on", 1, 65535),
+    OPTION_BOOLEAN("quiet", 'q', "Print nothing"));
+
+// Images are restored without writing to them: two read-only views of a shared memfd give args
+// pointing into their own view
+static void readOnlyImage(void) {
+    char* argv[] = {"p", "-n", "x", "-I", "a", "-P", "80", "-I", "b", "value", NULL};
+    CL_Args args = CL_parse(10, argv, listed);
+    size_t size = CL_serialize(&args, NULL, 0);
+    int fd = memfd_create("image", 0);
+    CHECK(fd >= 0 && ftruncate(fd, size) == 0);
+    char* image = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    CHECK(image != MAP_FAILED && CL_serialize(&args, image, size) == size);
+    CL_free(args);
+
+    char* views[2];
+    void* tables[2];
+    CL_Args restored[2];
+    for (int v = 0; v < 2; v++) {
+        views[v] = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+        CHECK(views[v] != MAP_FAILED);
+        size_t table_size = CL_deserializeTableSize(views[v], size);
+        CHECK(table_size > 0 && !CL_deserialize(views[v], size, listed, &restored[v], NULL, 0));
+        tables[v] = malloc(table_size);
+        CHECK(CL_deserialize(views[v], size, listed, &restored[v], tables[v], table_size));
+    }
+    for (int v = 0; v < 2; v++) {
+        CL_FlagValue name = CL_flagAt(&restored[v], 0);
+        CL_FlagValue include = CL_flagAt(&restored[v], 1);
+        CL_FlagValue port = CL_flagAt(&restored[v], 2);
+        CHECK(name.string >= views[v] && name.string < views[v] + size && strcmp(name.string, "x") == 0);
+        CHECK(include.list.count == 2 && strcmp(include.list.strings[1], "b") == 0 && include.list.strings[1] >= views[v] && include.list.strings[1] < views[v] + size);
+        CHECK(port.list.count == 1 && port.list.integers[0] == 80);
+        CHECK(restored[v].value_count == 1 && strcmp(restored[v].values[0], "value") == 0);
+        // Which options were set is restored too
+        CHECK(CL_isSet(&restored[v], 0) && CL_isSet(&restored[v], 2) && !CL_isSet(&restored[v], 3));
+        free(tables[v]);
+        munmap(views[v], size);
+    }
+    munmap(image, size);
+    close(fd);
+}
+
+int main(void) {
+    subcommandErrors();
+    constraintsAfterSubcommand();
+    allocatorCompiles();
+    zshProgname();
+    shellProgname();
+    printedUsage();
+    interruptedHelp();
+    integerConversions();
+    doubleConversions();
+    doublesInLocale();
+    readOnlyImage();
+    printf("all checks passed\n");
+    return EXIT_SUCCESS;
+}